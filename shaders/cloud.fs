@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// ------------------------------------------------------------------------ // 
+// Cloud rendering
+#include "cloud.glsl"
+#include "density.glsl"
+#include "march.glsl"
+#include "depth.glsl"
+#include "viewray.glsl"
+#include "cloudpass.glsl"
+
+// ------------------------------------------------------------------------ // 
+void main()
+{
+    vec2 coord = getCloudCoord(floor(gl_FragCoord.xy));
+    vec3 direction = getViewDirection(coord);
+    float sceneDist = getSceneDistance(coord);
+    fColor = getCloudPixel(direction, sceneDist, coord);    // premultiplied cloud color
+}
@@ -0,0 +1,45 @@
+// ------------------------------------------------------------------------ //
+// Cloud range shared by every cloud pass
+// bottom, top, width and densityCut are injected as #defines by getShaderProgram()
+
+// Coarsest coverage mip the samples read, the extent cells are widened to cover its footprint
+#define maxCoverageLod 2
+
+// Density high at middle and low at bottom and top
+float getHeightWeight(float y) {
+    float mid = (bottom+top)/2.0;
+    float h = top - bottom;
+    float weight = 1.0 - 2.0 * abs(mid - y) / h;
+    return pow(max(weight, 0.0), 0.5);
+}
+
+// From world xz position to coverage texture coord
+vec2 getCoverageCoord(vec2 xz) {
+    return xz / (2.0 * width) + 0.5;
+}
+
+// Height range of a column where coverage * height weight reaches the density cut
+// Solved from the height weight in closed form, empty range (x > y) if never reached
+vec2 getCloudExtent(float coverage) {
+    if(coverage <= densityCut) {
+        return vec2(top, bottom);
+    }
+    float mid = (bottom+top)/2.0;
+    float h = top - bottom;
+    float w = densityCut / coverage;
+    float e = 0.5 * h * (1.0 - w * w);
+    return vec2(mid - e, mid + e);
+}
+
+// Distance range [tmin, tmax] of a ray inside the cloud box and in front of the scene
+vec2 clipCloudRay(vec3 origin, vec3 direction, float sceneDist) {
+    vec3 boxMin = vec3(-width, bottom, -width);
+    vec3 boxMax = vec3(width, top, width);
+    vec3 t0 = (boxMin - origin) / direction;
+    vec3 t1 = (boxMax - origin) / direction;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float tmin = max(max(tNear.x, tNear.y), max(tNear.z, 0.0));
+    float tmax = min(min(tFar.x, tFar.y), tFar.z);
+    return vec2(tmin, min(tmax, sceneDist));
+}
@@ -0,0 +1,28 @@
+// ------------------------------------------------------------------------ //
+// Per pixel setup of the cloud pass, shared by the fragment and compute paths
+// Includes cloud.glsl, density.glsl, march.glsl, depth.glsl and viewray.glsl before this file
+
+// interleaved marching, each output texel marches one pixel of a block of the cloud target
+uniform vec2 cloudSize;             // cloud target resolution
+uniform int cloudBlock;             // block width in pixels, 1 marches every pixel
+uniform ivec2 cloudOffset;          // pixel of the block marched this frame
+
+// distant clouds are read from a panorama around the camera instead of marched
+uniform samplerCube panoramatex;
+uniform float panoramaDistance;     // sky rays entering the clouds past this use the panorama
+uniform bool panoramaReady;         // every face of the panorama has been rendered
+
+// Screen coord of the pixel marched by a texel of the output
+vec2 getCloudCoord(vec2 texel) {
+    return (texel * cloudBlock + vec2(cloudOffset) + 0.5) / cloudSize;
+}
+
+// Premultiplied cloud color of a pixel
+vec4 getCloudPixel(vec3 direction, float sceneDist, vec2 coord) {
+    // Far sky rays barely move with the camera, the panorama already holds them
+    vec2 range = clipCloudRay(cameraPos, direction, sceneDist);
+    if(panoramaReady && sceneDist == 1e30 && range.x > panoramaDistance && range.x < range.y) {
+        return texture(panoramatex, direction);
+    }
+    return getCloud(cameraPos, direction, sceneDist, getJitter(coord * cloudSize));
+}
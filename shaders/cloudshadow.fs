@@ -0,0 +1,44 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// inverse of the light source view projection matrix
+uniform mat4 inverseShadowVP;
+
+uniform int cloudShadowSteps;   // density samples along each light ray
+uniform float lightAbsorption;  // extinction per unit of density and distance
+
+#include "cloud.glsl"
+#include "density.glsl"
+
+void main()
+{
+    // Light ray of this texel from the near to the far plane of the light source
+    vec2 ndc = texcoord * 2.0 - 1.0;
+    vec4 nearPos = inverseShadowVP * vec4(ndc, -1.0, 1.0);
+    vec4 farPos = inverseShadowVP * vec4(ndc, 1.0, 1.0);
+    vec3 origin = nearPos.xyz / nearPos.w;
+    vec3 toFar = farPos.xyz / farPos.w - origin;
+    float rayLength = length(toFar);
+    vec3 direction = toFar / rayLength;
+
+    // Transmittance through the clouds, and depth where the clouds start
+    vec2 range = clipCloudRay(origin, direction, rayLength);
+    float opticalDepth = 0.0;
+    float entry = rayLength;
+    if(range.x < range.y) {
+        float stepLength = (range.y - range.x) / float(cloudShadowSteps);
+        for(int i=0; i<cloudShadowSteps; i++) {
+            float t = range.x + (float(i) + 0.5) * stepLength;
+            float density = getDensity(origin + direction * t, stepLength);
+            if(density > 0.0 && opticalDepth == 0.0) {
+                entry = t - 0.5 * stepLength;
+            }
+            opticalDepth += density * stepLength;
+        }
+    }
+
+    // Orthographic light source, so the depth is linear along the ray
+    fColor = vec4(exp(-lightAbsorption * opticalDepth), entry / rayLength, 0.0, 1.0);
+}
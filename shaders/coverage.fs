@@ -0,0 +1,66 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+uniform int FrameCounter;
+
+uniform sampler2D shapetex;     // tileable perlin-worley
+uniform float shapeFrequency;   // lattice cells per tile of the shape texture
+
+#include "cloud.glsl"
+
+// One fetch of the shape texture, one lattice cell per unit like the hash noise it replaces
+// Perlin-worley is brighter and flatter than value noise, so its mean and contrast are matched
+// The top level is fetched without mip selection, like the point evaluated hash it replaces
+float noise (in vec2 st) {
+    float n = textureLod(shapetex, st / shapeFrequency, 0.0).r;
+    return clamp((n - 0.58) * 1.21 + 0.5, 0.0, 1.0);
+}
+
+// NUM_OCTAVES is injected by the quality tier, the bake keeps all of them whatever the view
+// and the samples pick a mip level of the coverage from their footprint instead
+float fbm ( in vec2 st) {
+    float v = 0.0;
+    float a = 0.5;
+    vec2 shift = vec2(100.0);
+    // Rotate to reduce axial bias
+    mat2 rot = mat2(cos(0.5), sin(0.5),
+                    -sin(0.5), cos(0.50));
+    for (int i = 0; i < NUM_OCTAVES; ++i) {
+        v += a * noise(st);
+        st = rot * st * 2.0 + shift;
+        a *= 0.5;
+    }
+    return v;
+}
+
+// Cloud coverage of a xz column, the height weight is applied when marching
+float getCoverage(vec2 pos) {
+    vec2 coord = pos * 0.2;
+
+    vec2 q = vec2(0.);
+    q.x = fbm( coord );
+    q.y = fbm( coord + vec2(1.0));
+
+    vec2 r = vec2(0.);
+    r.x = fbm( coord + 1.0*q + vec2(1.7,9.2)+ 0.15 * float(FrameCounter)*0.006 );
+    r.y = fbm( coord + 1.0*q + vec2(8.3,2.8)+ 0.126 * float(FrameCounter)*0.006 );
+
+    float f = fbm(coord+r);
+
+    float noise = mix(0, 1, clamp((f*f)*4.0,0.0,1.0));
+    noise = mix(noise, 0.5, clamp(length(q),0.0,1.0));
+    noise =  mix(noise, 1.024, clamp(length(r.x),0.0,1.0));
+
+    noise = (f*f*f+.6*f*f+.5*f) * noise;
+
+    return noise;
+}
+
+void main()
+{
+    // texel center to world xz position in [-width, width]
+    vec2 pos = (texcoord * 2.0 - 1.0) * width;
+    fColor = vec4(getCoverage(pos), 0.0, 0.0, 1.0);
+}
@@ -6,12 +6,16 @@ out vec4 fColor;
 uniform sampler2D gcolor;
 uniform sampler2D gnormal;
 uniform sampler2D gdepth;
-uniform sampler2D gworldpos;
 uniform sampler2D shadowtex;
 
 uniform float near;
 uniform float far;
 
+uniform mat4 inverseVP;
+
+#include "gbuffer.glsl"
+#include "depth.glsl"
+
 float linearizeDepth(float depth, float near, float far) {
     return (2.0 * near) / (far + near - depth * (far - near));
 }
@@ -29,7 +33,7 @@ void main()
     if(0.5<=texcoord.x && texcoord.x<=1 && 0<=texcoord.y && texcoord.y<=0.5)
     {
         vec2 coord = vec2(texcoord.x*2-1, texcoord.y*2);
-        fColor = vec4(texture2D(gnormal, coord).rgb, 1); 
+        fColor = vec4(decodeNormal(texture2D(gnormal, coord).xy), 1); 
     }
 
     // Ļʾ gdepth
@@ -45,6 +49,6 @@ void main()
     if(0.5<=texcoord.x && texcoord.x<=1 && 0.5<=texcoord.y && texcoord.y<=1)
     {
         vec2 coord = vec2(texcoord.x*2-1, texcoord.y*2-1);
-        fColor = vec4(texture2D(gworldpos, coord).rgb, 1); 
+        fColor = vec4(getWorldPos(inverseVP, coord, texture2D(gdepth, coord).r), 1); 
     }
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+// ------------------------------------------------------------------------ //
+// Cloud density shared by the passes sampling the clouds, needs cloud.glsl
+uniform sampler2D coveragetex;
+uniform sampler3D detailtex;    // tileable worley fbm
+
+#define detailScale 0.15        // detail tiles per world unit
+#define detailErosion 0.4       // how much of a thin cloud the detail noise can erode
+
+// Cloud density before the detail erosion, an upper bound of getDensity()
+// One fetch of the baked coverage times the height weight, cut to individuals
+// The mip level follows the footprint, so far samples average the octaves they cannot resolve,
+// up to maxCoverageLod, which the baked extents are widened for
+float getBaseDensity(vec3 pos, float footprint) {
+    float coverageLod = log2(footprint * float(textureSize(coveragetex, 0).x) / (2.0 * width));
+    float noise = textureLod(coveragetex, getCoverageCoord(pos.xz), clamp(coverageLod, 0.0, float(maxCoverageLod))).r;
+    noise *= getHeightWeight(pos.y);
+    return noise < densityCut ? 0.0 : noise;
+}
+
+// Cloud density, footprint is the world size one sample stands for
+float getDensity(vec3 pos, float footprint) {
+    float noise = getBaseDensity(pos, footprint);
+    if(noise == 0.0){
+        return 0.0;
+    }
+
+    // Erode the thin edges with detail noise, dense cores are kept
+    // Density only decreases from the base density, so the baked extents stay conservative
+    // Mip level follows the footprint, and the detail fades out before it is a pixel wide
+    float detailLod = log2(footprint * detailScale * float(textureSize(detailtex, 0).x));
+    float detailFade = 1.0 - smoothstep(1.5, 3.0, detailLod);
+    if(detailFade > 0.0) {
+        noise -= detailFade * detailErosion * textureLod(detailtex, pos * detailScale, max(detailLod, 0.0)).r * (1.0 - noise);
+    }
+    if(noise < densityCut){
+        noise = 0;
+    }
+    return noise;
+}
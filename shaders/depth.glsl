@@ -0,0 +1,13 @@
+// ------------------------------------------------------------------------ //
+// Scene depth helpers shared by the passes reading gdepth
+
+// The sky is drawn without depth writes, so its depth stays at the cleared 1
+bool isSky(float depth) {
+    return depth == 1.0;
+}
+
+// World position of the point at a screen coord and depth, the sky lands on the far plane
+vec3 getWorldPos(mat4 inverseVP, vec2 coord, float depth) {
+    vec4 worldPos = inverseVP * vec4(vec3(coord, depth) * 2.0 - 1.0, 1.0);
+    return worldPos.xyz / worldPos.w;
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+uniform sampler2D coveragetex;
+uniform int cellSize;   // coverage texels per extent texel
+
+#include "cloud.glsl"
+
+void main()
+{
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(coveragetex, 0);
+
+    // Max coverage of every texel a fetch inside the cell may touch, a bilinear fetch at mip level
+    // L averages texels up to 1.5 * 2^L away, and a mip texel is never above its base texels
+    int border = (3 << maxCoverageLod) / 2;
+    float maxCoverage = 0.0;
+    for(int x = -border; x < cellSize + border; x++) {
+        for(int y = -border; y < cellSize + border; y++) {
+            ivec2 coord = clamp(cell * cellSize + ivec2(x, y), ivec2(0), size - 1);
+            maxCoverage = max(maxCoverage, texelFetch(coveragetex, coord, 0).r);
+        }
+    }
+
+    fColor = vec4(getCloudExtent(maxCoverage), 0.0, 1.0);
+}
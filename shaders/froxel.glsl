@@ -0,0 +1,16 @@
+// ------------------------------------------------------------------------ //
+// Camera aligned froxel volume, screen uv in xy and exponential depth slices
+// between froxelNear and froxelFar along the view ray
+
+uniform float froxelNear;
+uniform float froxelFar;
+
+// Distance along the view ray of a slice coord in [0, 1]
+float getSliceDistance(float w) {
+    return froxelNear * pow(froxelFar / froxelNear, w);
+}
+
+// Slice coord in [0, 1] of a distance along the view ray
+float getSliceCoord(float dist) {
+    return clamp(log(dist / froxelNear) / log(froxelFar / froxelNear), 0.0, 1.0);
+}
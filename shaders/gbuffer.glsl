@@ -0,0 +1,25 @@
+// ------------------------------------------------------------------------ //
+// Gbuffer packing shared by the passes writing and reading the gbuffer
+// Normals are octahedral encoded in two channels, positions are rebuilt from the depth by depth.glsl
+
+// Encoded normal of the sky, which is not lit
+const vec2 skyNormal = vec2(0.0);
+
+// Sign that is never 0, so the folded octahedron has no seam on the axes
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit normal to [-1, 1]^2, the lower hemisphere is folded over the diagonals
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    }
+    return normalize(n);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// Top level of the Hi-Z pyramid, min and max scene depth of every pixel
+uniform sampler2D gdepth;
+
+void main()
+{
+    float depth = texelFetch(gdepth, ivec2(gl_FragCoord.xy), 0).r;
+    fColor = vec4(depth, depth, 0.0, 1.0);
+}
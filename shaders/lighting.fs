@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+uniform vec3 lightPos;
+
+uniform int layer;              // height layer of the volume written by this pass
+uniform int layers;             // height layers of the volume
+uniform int lightSteps;         // density samples towards the light
+uniform float lightAbsorption;  // extinction per unit of density and distance
+
+#include "cloud.glsl"
+#include "density.glsl"
+
+void main()
+{
+    // Voxel center, xz over the cloud range and one layer of the slab in height
+    float y = bottom + (float(layer) + 0.5) / float(layers) * (top - bottom);
+    vec3 pos = vec3((texcoord.x * 2.0 - 1.0) * width, y, (texcoord.y * 2.0 - 1.0) * width);
+
+    // March towards the light until it or the slab boundary is reached
+    vec3 toLight = lightPos - pos;
+    vec3 L = normalize(toLight);
+    float dist = clipCloudRay(pos, L, length(toLight)).y;
+    float stepLength = max(dist, 0.0) / float(lightSteps);
+
+    float opticalDepth = 0.0;
+    for(int i=0; i<lightSteps; i++) {
+        opticalDepth += getDensity(pos + L * (float(i) + 0.5) * stepLength, stepLength) * stepLength;
+    }
+
+    fColor = vec4(exp(-lightAbsorption * opticalDepth), 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,251 @@
+// ------------------------------------------------------------------------ //
+// Cloud ray march shared by the cloud and panorama passes
+// Includes cloud.glsl and density.glsl before this file
+
+uniform sampler2D extenttex;        // min/max height pyramid
+uniform sampler2D noisetex;         // blue noise slices stacked vertically
+uniform sampler3D lighttex;         // transmittance towards the light, depth is height
+
+// lighting lookup tables built on the cpu by buildCloudLuts()
+uniform sampler1D phasetex;         // dual-lobe henyey-greenstein phase times the light color, over the cosine to the light
+uniform sampler1D basetex;          // base color over density
+uniform sampler1D ambienttex;       // ambient color over the height in the slab
+uniform sampler2D opacitytex;       // optical depth above four heights of each column
+uniform float ambientAbsorption;    // sky light extinction per unit of density above
+uniform vec3 lightPos;
+
+// light march, a few density taps along a cone towards the light before the baked volume
+uniform int lightTaps;              // taps per lit sample, 0 to 6, 0 reads the volume only
+uniform float lightTapLength;       // length of the first tap segment, each next one is 1.5 times longer
+uniform float lightTapThreshold;    // view ray density under which the taps are skipped
+uniform float lightConeAngle;       // cone radius per unit of distance from the sample
+uniform float lightAbsorption;      // extinction per unit of density and distance
+
+// Unit offsets spreading the taps over the cone
+const vec3 coneKernel[6] = vec3[](
+    vec3(0.38, 0.92, -0.10),
+    vec3(-0.71, 0.31, 0.63),
+    vec3(0.11, -0.52, 0.85),
+    vec3(-0.27, -0.83, -0.49),
+    vec3(0.91, -0.08, -0.41),
+    vec3(-0.55, 0.47, -0.69)
+);
+
+// cloud ray marching quality, MARCH_STEPS and OPACITY_THRESHOLD are injected by the quality tier
+uniform float marchStepSize;        // fine step length at the start of the ray
+uniform float marchStepGrowth;      // step length grows by this ratio every step
+uniform float coarseStepRatio;      // stride through empty space in fine steps
+uniform float cloudExtinction;      // extinction per unit of density and distance
+
+uniform int noiseSlice;             // blue noise slice of this frame
+uniform float pixelAngle;           // size of a cloud pixel per unit of distance
+uniform int extentLevels;           // mip levels of the extent texture
+uniform float marchStart;           // distance where marching starts, nearer clouds are in the froxel volume
+
+// Texture coord of a value in [0, 1] hitting the first and last texel centers of a lut
+float getLutCoord(float x, int size) {
+    return (clamp(x, 0.0, 1.0) * float(size - 1) + 0.5) / float(size);
+}
+
+// Optical depth of the column above a point, one fetch of the vertical opacity map
+// interpolated between the baked heights, the top of the slab has none above
+float getOpticalDepthAbove(vec3 pos) {
+    vec4 opacity = texture(opacitytex, getCoverageCoord(pos.xz));
+    float h = clamp((pos.y - bottom) / (top - bottom), 0.0, 1.0) * 4.0;
+    float below = h < 1.0 ? opacity.x : h < 2.0 ? opacity.y : h < 3.0 ? opacity.z : opacity.w;
+    float above = h < 1.0 ? opacity.y : h < 2.0 ? opacity.z : h < 3.0 ? opacity.w : 0.0;
+    return mix(below, above, fract(min(h, 3.999)));
+}
+
+// Light scattered towards the camera at a point per unit of extinction, from the lookup tables
+// The base color scatters the sky light and the direct light, only the direct light is attenuated
+// by the transmittance towards the light, the sky light is occluded by the cloud above instead,
+// which darkens the bases of thick clouds
+vec3 getRadiance(vec3 pos, vec3 direction, float density, float transmittance) {
+    float cosTheta = dot(direction, normalize(lightPos - pos));
+    vec3 direct = texture(phasetex, getLutCoord(cosTheta * 0.5 + 0.5, textureSize(phasetex, 0))).rgb * transmittance;
+    vec3 base = texture(basetex, getLutCoord(density, textureSize(basetex, 0))).rgb;
+    vec3 ambient = texture(ambienttex, getLutCoord((pos.y - bottom) / (top - bottom), textureSize(ambienttex, 0))).rgb;
+    ambient *= exp(-ambientAbsorption * getOpticalDepthAbove(pos));
+    return base * (ambient + direct);
+}
+
+// Transmittance towards the light, density taps along a cone near the sample catch the detail
+// the baked volume is too coarse for, the volume covers the rest of the way from the last tap
+// Taps step further and read coarser detail as they go, thin density skips them
+float getLightTransmittance(vec3 pos, float density) {
+    vec3 L = normalize(lightPos - pos);
+    int taps = density < lightTapThreshold ? 0 : lightTaps;
+
+    float opticalDepth = 0.0;
+    float dist = 0.0;
+    float segment = lightTapLength;
+    for(int i=0; i<taps; i++) {
+        float tapDist = dist + 0.5 * segment;
+        vec3 tap = pos + L * tapDist + coneKernel[i] * lightConeAngle * tapDist;
+        opticalDepth += getDensity(tap, segment) * segment;
+        dist += segment;
+        segment *= 1.5;
+    }
+
+    vec3 end = pos + L * dist;
+    vec3 coord = vec3(getCoverageCoord(end.xz), (end.y - bottom) / (top - bottom));
+    return exp(-lightAbsorption * opticalDepth) * texture(lighttex, coord).r;
+}
+
+// Distance to move along the ray to reach the occupied height range of the current column
+// Walks the extent pyramid like Hi-Z tracing: a cell the ray misses is skipped whole and the
+// next test goes one level coarser, an occupied cell descends until the finest level
+// Returns 0 inside the range, or the distance out of the cell the ray misses there
+float skipEmpty(vec3 pos, vec3 direction, inout int level) {
+    for(;;) {
+        // Level size from the base, textureSize with a per pixel level is not reliable everywhere
+        vec2 cellSize = vec2(2.0 * width) / vec2(max(textureSize(extenttex, 0) >> level, 1));
+        vec2 cell = floor((pos.xz + width) / cellSize);
+        vec2 extent = texelFetch(extenttex, ivec2(cell), level).rg;
+
+        // Distance to leave the column through its xz sides
+        vec2 cellMin = cell * cellSize - width;
+        vec2 side = mix(cellMin, cellMin + cellSize, step(0.0, direction.xz));
+        vec2 sideDist = (side - pos.xz) / direction.xz;
+        float exitDist = min(sideDist.x, sideDist.y) + 0.001;
+
+        // Empty column
+        if(extent.x > extent.y) {
+            level = min(level + 1, extentLevels - 1);
+            return exitDist;
+        }
+
+        // Distance range along the ray inside [extent.x, extent.y]
+        float enter = 0.0;
+        float leave = exitDist;
+        if(direction.y != 0.0) {
+            vec2 dist = (extent - pos.y) / direction.y;
+            enter = max(min(dist.x, dist.y), 0.0);
+            leave = max(dist.x, dist.y);
+        } else if(pos.y < extent.x || extent.y < pos.y) {
+            level = min(level + 1, extentLevels - 1);
+            return exitDist;
+        }
+
+        if(enter >= leave || enter >= exitDist) {
+            level = min(level + 1, extentLevels - 1);
+            return exitDist;
+        }
+        // Outside the range, or at the finest level inside it
+        if(enter > 0.0 || level == 0) {
+            return enter;
+        }
+        level--;
+    }
+}
+
+// Jitter of the ray start in [0, 1) steps from the blue noise slice of this frame
+float getJitter(vec2 pixel) {
+    int size = textureSize(noisetex, 0).x;
+    ivec2 p = ivec2(pixel) % size;
+    return texelFetch(noisetex, ivec2(p.x, p.y + noiseSlice * size), 0).r;
+}
+
+// Light a sample and integrate it over its step (Hillaire 2015): scattering is constant along the
+// segment and attenuated by Beer-Lambert inside it, which is exact at any length while the density
+// holds. Scattering equals extinction, so the integral reduces to radiance * (1 - Tr)
+void integrateStep(vec3 point, vec3 direction, float density, float stepLength, inout vec4 colorSum, inout float transmittance) {
+    float delta = getLightTransmittance(point, density);
+    vec3 radiance = getRadiance(point, direction, density, delta);
+
+    float stepTransmittance = exp(-density * cloudExtinction * stepLength);
+    colorSum.rgb += transmittance * radiance * (1.0 - stepTransmittance);
+    transmittance *= stepTransmittance;
+    colorSum.a = 1.0 - transmittance;
+}
+
+// Cloud color
+vec4 getCloud(vec3 cameraPos, vec3 direction, float sceneDist, float jitter) {
+    vec4 colorSum = vec4(0);        // accumlated color, alpha is one minus the transmittance
+    float transmittance = 1.0;      // transmittance from the camera to the current point
+
+    // Stop test if the ray misses the cloud or the target pixel cover the cloud
+    vec2 range = clipCloudRay(cameraPos, direction, sceneDist);
+    range.x = max(range.x, marchStart);
+    if(range.x >= range.y) {
+        return vec4(0);
+    }
+
+#ifdef REFERENCE_MARCH
+    // Reference of the error harness, MARCH_STEPS even steps over the whole range without
+    // skipping, striding or jitter
+    float stepLength = (range.y - range.x) / float(MARCH_STEPS);
+    for(int i=0; i<MARCH_STEPS && colorSum.a <= OPACITY_THRESHOLD; i++) {
+        float t = range.x + (float(i) + 0.5) * stepLength;
+        vec3 point = cameraPos + direction * t;
+        float density = getDensity(point, t * pixelAngle);
+        if(density > 0.0) {
+            integrateStep(point, direction, density, stepLength, colorSum, transmittance);
+        }
+    }
+#else
+    // Ray Marching, empty air is skipped per column and does not count as a step
+    // Stride coarsely until density shows up, then back up and continue with fine steps
+    bool coarse = true;
+    int emptyCount = 0;             // fine steps in a row without density
+    float lastEmpty = range.x;      // last distance known to be empty
+    int level = extentLevels - 1;                   // extent pyramid level of the skip test
+    float t = range.x;
+    float phase = 1.0;              // fraction of the next fine step, blue noise on the first of a run
+    int i = 0;
+    for(int n=0; i<MARCH_STEPS && n<MARCH_STEPS+256; n++) {
+        if(t > range.y || colorSum.a > OPACITY_THRESHOLD) {
+            break;
+        }
+        vec3 point = cameraPos + direction * t;
+
+        // Land on the occupied range, the first fine step from there is a partial one so the
+        // whole range is integrated and the samples keep a jittered phase
+        float skip = skipEmpty(point, direction, level);
+        if(skip > 0.0) {
+            t += skip;
+            lastEmpty = t;
+            phase = jitter;
+            continue;
+        }
+
+        // Coarse strides only look for the cloud, the base density bounds the eroded one and is
+        // smoother, so strides miss less of the thin detail
+        float stepLength = marchStepSize * (1.0 + i * marchStepGrowth);
+        float density = coarse ? getBaseDensity(point, t * pixelAngle) : getDensity(point, t * pixelAngle);
+        i++;
+
+        if(coarse) {
+            // Fine steps from the last empty sample, the partial first one puts the samples
+            // on a jittered phase, which hides the banding of few steps
+            if(density > 0.0) {
+                coarse = false;
+                emptyCount = 0;
+                t = lastEmpty;
+                phase = jitter;
+            } else {
+                lastEmpty = t;
+                t += stepLength * coarseStepRatio;
+            }
+            continue;
+        }
+        stepLength *= phase;
+        phase = 1.0;
+        if(density == 0.0) {
+            emptyCount++;
+            coarse = emptyCount >= 4;
+            lastEmpty = t;
+            t += stepLength;
+            continue;
+        }
+        emptyCount = 0;
+
+        integrateStep(point, direction, density, stepLength, colorSum, transmittance);
+        t += stepLength;
+    }
+#endif
+
+    return colorSum;
+}
+
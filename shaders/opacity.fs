@@ -0,0 +1,32 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+uniform int opacitySteps;       // density samples down each column, a multiple of 4
+
+#include "cloud.glsl"
+#include "density.glsl"
+
+// Optical depth of the column above the bottom of the slab and above 1/4, 1/2 and 3/4 of its height
+// The top has none, march.glsl interpolates between the five heights
+void main()
+{
+    vec2 xz = (texcoord * 2.0 - 1.0) * width;
+    float stepLength = (top - bottom) / float(opacitySteps);
+    int quarter = opacitySteps / 4;
+
+    vec4 opacity = vec4(0.0);
+    float opticalDepth = 0.0;
+    for(int i=0; i<opacitySteps; i++) {
+        float y = top - (float(i) + 0.5) * stepLength;
+        opticalDepth += getDensity(vec3(xz.x, y, xz.y), stepLength) * stepLength;
+
+        // Reached the next quarter height going down
+        if((i + 1) % quarter == 0) {
+            opacity[3 - i / quarter] = opticalDepth;
+        }
+    }
+
+    fColor = opacity;
+}
@@ -0,0 +1,33 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// Low resolution cloud panorama around the camera, one cube face is rendered per pass
+// and the faces are refreshed in turn, a few rows of a face at a time
+
+uniform vec3 cameraPos;             // panorama center
+uniform int panoramaFace;           // cube face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+uniform float panoramaSize;         // face resolution
+
+#include "cloud.glsl"
+#include "density.glsl"
+#include "march.glsl"
+
+// World space direction of a texel of a cube face, following the GL cube map face layout
+vec3 getFaceDirection(int face, vec2 st) {
+    if(face == 0) return vec3(1.0, -st.y, -st.x);
+    if(face == 1) return vec3(-1.0, -st.y, st.x);
+    if(face == 2) return vec3(st.x, 1.0, st.y);
+    if(face == 3) return vec3(st.x, -1.0, -st.y);
+    if(face == 4) return vec3(st.x, -st.y, 1.0);
+    return vec3(-st.x, -st.y, -1.0);
+}
+
+void main()
+{
+    // the viewport covers only the rows updated this frame, gl_FragCoord stays in face pixels
+    vec2 st = gl_FragCoord.xy / panoramaSize * 2.0 - 1.0;
+    vec3 direction = normalize(getFaceDirection(panoramaFace, st));
+    fColor = getCloud(cameraPos, direction, 1e30, getJitter(gl_FragCoord.xy));
+}
@@ -0,0 +1,27 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// min/max pyramid with only the finer level visible, so lod 0 is the level below
+uniform sampler2D pyramidtex;
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy) * 2;
+
+    // An odd last row or column of the level below folds into the last texel, and a level
+    // below that is one texel wide or high has no second one
+    ivec2 size = textureSize(pyramidtex, 0);
+    ivec2 last = min(p + 1 + ivec2(equal(p + 3, size)), size - 1);
+
+    // Union of the ranges, an empty extent (x > y) stays empty only if all are empty
+    vec2 range = vec2(1e30, -1e30);
+    for(int x = p.x; x <= last.x; x++) {
+        for(int y = p.y; y <= last.y; y++) {
+            vec2 texel = texelFetch(pyramidtex, ivec2(x, y), 0).rg;
+            range = vec2(min(range.x, texel.x), max(range.y, texel.y));
+        }
+    }
+    fColor = vec4(range, 0.0, 1.0);
+}
@@ -0,0 +1,62 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+// texture data
+uniform sampler2D marchtex;     // pixels marched this frame, one per block
+uniform sampler2D historytex;   // full cloud target of the previous frame
+
+// view projection matrix of the camera in the previous frame
+uniform mat4 prevVP;
+
+uniform int cloudBlock;         // block width in pixels
+uniform ivec2 cloudOffset;      // pixel of the block marched this frame
+uniform bool historyValid;      // false on the first frame, history is garbage
+
+#include "cloud.glsl"
+#include "depth.glsl"
+#include "viewray.glsl"
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 block = pixel / cloudBlock;
+    vec4 current = texelFetch(marchtex, block, 0);
+
+    // Marched this frame
+    if(pixel == block * cloudBlock + cloudOffset) {
+        fColor = current;
+        return;
+    }
+
+    // No cloud can be on a ray missing the cloud box
+    vec3 direction = getViewDirection(texcoord);
+    vec2 range = clipCloudRay(cameraPos, direction, getSceneDistance(texcoord));
+    if(range.x >= range.y) {
+        fColor = vec4(0);
+        return;
+    }
+
+    // Reproject the middle of the cloud segment into the previous frame
+    vec4 prevPos = prevVP * vec4(cameraPos + direction * 0.5 * (range.x + range.y), 1.0);
+    vec2 prevCoord = prevPos.xy / prevPos.w * 0.5 + 0.5;
+    if(!historyValid || prevPos.w <= 0.0 || any(lessThan(prevCoord, vec2(0.0))) || any(greaterThan(prevCoord, vec2(1.0)))) {
+        fColor = current;
+        return;
+    }
+
+    // Clamp history to the fresh samples around the block to reject disocclusions
+    ivec2 maxBlock = textureSize(marchtex, 0) - 1;
+    vec4 minColor = current;
+    vec4 maxColor = current;
+    for(int y=-1; y<=1; y++) {
+        for(int x=-1; x<=1; x++) {
+            vec4 neighbour = texelFetch(marchtex, clamp(block + ivec2(x, y), ivec2(0), maxBlock), 0);
+            minColor = min(minColor, neighbour);
+            maxColor = max(maxColor, neighbour);
+        }
+    }
+
+    fColor = clamp(texture(historytex, prevCoord), minColor, maxColor);
+}
@@ -0,0 +1,11 @@
+// ------------------------------------------------------------------------ //
+// Tiles of the cloud output sorted by class, written by classify.comp and
+// read by the cloud.comp kernel of each class
+
+#define TILE_SIZE 16
+
+layout(std430, binding = 0) buffer TileLists {
+    uint dispatchArgs[6];   // indirect dispatch of the sky tiles, then of the full tiles
+    uint tiles[];           // sky tiles from 0, full tiles from tileCapacity, packed x | y << 16
+};
+uniform uint tileCapacity;  // tiles of the largest cloud output
@@ -0,0 +1,42 @@
+#version 330 core
+
+in vec2 texcoord;
+out vec4 fColor;
+
+uniform sampler2D scenetex;     // composited frame at the gbuffer resolution
+
+// Catmull-Rom filtered fetch from 9 bilinear taps, sharper than bilinear when upscaling
+// The weights of the two middle texels of each axis are merged into one bilinear tap
+vec3 sampleCatmullRom(sampler2D tex, vec2 coord) {
+    vec2 size = vec2(textureSize(tex, 0));
+    vec2 pos = coord * size;
+    vec2 center = floor(pos - 0.5) + 0.5;
+    vec2 f = pos - center;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    vec2 w12 = w1 + w2;
+
+    vec2 coord0 = (center - 1.0) / size;
+    vec2 coord12 = (center + w2 / w12) / size;
+    vec2 coord3 = (center + 2.0) / size;
+
+    vec3 color = vec3(0.0);
+    color += texture(tex, vec2(coord0.x, coord0.y)).rgb * w0.x * w0.y;
+    color += texture(tex, vec2(coord12.x, coord0.y)).rgb * w12.x * w0.y;
+    color += texture(tex, vec2(coord3.x, coord0.y)).rgb * w3.x * w0.y;
+    color += texture(tex, vec2(coord0.x, coord12.y)).rgb * w0.x * w12.y;
+    color += texture(tex, vec2(coord12.x, coord12.y)).rgb * w12.x * w12.y;
+    color += texture(tex, vec2(coord3.x, coord12.y)).rgb * w3.x * w12.y;
+    color += texture(tex, vec2(coord0.x, coord3.y)).rgb * w0.x * w3.y;
+    color += texture(tex, vec2(coord12.x, coord3.y)).rgb * w12.x * w3.y;
+    color += texture(tex, vec2(coord3.x, coord3.y)).rgb * w3.x * w3.y;
+    return max(color, 0.0);
+}
+
+void main()
+{
+    fColor = vec4(sampleCatmullRom(scenetex, texcoord), 1.0);
+}
@@ -0,0 +1,29 @@
+// ------------------------------------------------------------------------ //
+// Camera rays of the passes drawn over the screen, shared by the cloud and reprojection passes
+// Includes depth.glsl before this file
+
+uniform sampler2D gdepth;
+
+// inverse of the camera view projection matrix
+uniform mat4 inverseVP;
+
+uniform vec3 cameraPos;
+
+// World space view direction of a screen coord
+vec3 getViewDirection(vec2 coord) {
+    vec4 farPos = inverseVP * vec4(coord * 2.0 - 1.0, 1.0, 1.0);
+    return normalize(farPos.xyz / farPos.w - cameraPos);
+}
+
+// Distance from the camera to the point of a screen coord at a depth, sky is infinitely far
+float getDepthDistance(vec2 coord, float depth) {
+    if(isSky(depth)) {
+        return 1e30;
+    }
+    return length(getWorldPos(inverseVP, coord, depth) - cameraPos);
+}
+
+// Distance from the camera to the scene at a screen coord
+float getSceneDistance(vec2 coord) {
+    return getDepthDistance(coord, texture(gdepth, coord).r);
+}
@@ -6,6 +6,8 @@
 #include <map>
 #include <sstream>
 #include <iostream>
+#include <thread>
+#include <algorithm>
 
 // glew glut
 #include <GL/glew.h>
@@ -289,18 +291,224 @@ bool keyboardState[1024];   // true means the specific key is pressed
 
 int FrameCounter = 0;
 
+// linked programs per permutation, keyed on shader files and injected #defines
+std::map<std::string, GLuint> programCache;
+
 // Deferred Rendering
 GLuint gbufferProgram;
 GLuint gbufferFBO;  
 GLuint gcolor;      // base color texture
 GLuint gdepth;      // depth texture
-GLuint gworldpos;   // world position texture
-GLuint gnormal;     // normal texture
+GLuint gnormal;     // normal texture, octahedral encoded
+bool compactGBuffer = true; // sRGB RGBA8 color and RG16 snorm normal, or RGBA8 and RG32F, off with --plain-gbuffer
+
+// dynamic resolution, the gbuffer and the cloud target are scaled down from the window size
+// to hold a gpu frame time, and the composited frame is upscaled to the window
+int renderWidth = 512;          // gbuffer resolution
+int renderHeight = 512;
+float renderScale = 1.0;        // gbuffer size over the window size
+float cloudScale = 1.0;         // cloud target size over its size at full resolution
+bool dynamicResolution = false; // toggled by 'v'
+float targetFrameTime = 16.0;   // gpu milliseconds per frame held by the controller
+float minRenderScale = 0.5;
+float minCloudScale = 0.25;     // clouds are soft and upsampled by depth, they can go lower
+float scaleStep = 0.125;        // scales move one step per averaging window, so targets are rarely reallocated
+float scaleHysteresis = 0.0625; // a scale steps down only once its budget is this far below it
+GLuint upscaleProgram;
+GLuint sceneFBO;
+GLuint scenetex;                // composited frame at the gbuffer resolution
+
+// gpu timestamps around the scaled passes, kept for a ring of frames so results are read without a stall
+enum { STAMP_FRAME_BEGIN, STAMP_GBUFFER_BEGIN, STAMP_GBUFFER_END, STAMP_CLOUD_BEGIN, STAMP_CLOUD_END, STAMP_COMPOSITE_END, STAMP_FRAME_END, STAMPS };
+const int timerFrames = 3;
+GLuint timerQueries[timerFrames][STAMPS];
+float timerScales[timerFrames][2];  // render and cloud scale the frame was drawn at
+int timerFrame = 0;                 // frames drawn with timestamps
+// frame times are averaged over a window before the scales move, a multiple of cloudUpdateInterval
+// so the cloud bake every few frames is spread over the window instead of landing on one frame
+const int timerAverageFrames = 16;
+float timerSums[3];                 // full resolution scene and cloud time and fixed time over the window
+int timerSamples = 0;               // frames summed in the window
 GLuint noisetex;    // nosie texture
+int noiseSlices = 16;   // blue noise slices in noisetex, cycled per frame
+
+// tileable noise textures, generated once and cached in cache/
+GLuint shapetex;            // 2D perlin-worley, sampled by the coverage bake
+GLuint detailtex;           // 3D worley fbm, erodes cloud edges
+const int noiseVersion = 2; // generator version in the cache key, stale caches are regenerated
+int shapeResolution = 128;
+int shapeFrequency = 4;     // lattice cells per tile of the lowest octave
+int detailResolution = 32;
+int detailFrequency = 2;
+unsigned int noiseSeed = 1;
 
 // post processing
 GLuint composite0;
 
+// cloud coverage, baked once per frame over the [-width, width] cloud range
+GLuint coverageProgram;
+GLuint coverageFBO;
+GLuint coveragetex;     // coverage texture
+int coverageResolution = 1024;
+
+// per column height range of the clouds, used to skip empty air when marching
+GLuint extentProgram;
+GLuint extentFBO;
+GLuint extenttex;       // min/max height texture
+int extentCellSize = 8; // coverage texels per extent texel
+int extentLevels;       // mip levels, each one the min/max of four texels below
+GLuint reduceProgram;   // builds a level of a min/max pyramid from the level below
+
+// Hi-Z pyramid of the scene depth, rebuilt after the gbuffer pass to reject occluded cloud tiles
+GLuint hizProgram;
+GLuint hizFBO;
+GLuint hiztex;          // min/max depth texture with a full mip chain at the gbuffer resolution
+int hizLevels;
+
+// optical depth of the cloud above four heights of each column, occludes the sky light of the clouds
+GLuint opacityProgram;
+GLuint opacityFBO;
+GLuint opacitytex;              // vertical opacity map over the cloud range
+int opacityResolution = 256;
+int opacitySteps = 16;          // density samples down each column, a multiple of 4
+float ambientAbsorption = 0.25; // sky light extinction per unit of density above
+
+// cloud animation is slow, so coverage, extents and lighting are only rebaked every few frames
+int cloudUpdateInterval = 4;
+bool cloudBaked = false;        // false until the first bake
+
+// transmittance from every point of the cloud slab towards the light, rebaked when the light moves
+GLuint lightingProgram;
+GLuint lightingFBO;
+GLuint lighttex;                // 3D texture over the slab, xz then height as depth
+int lightResolution = 128;      // xz resolution of the volume
+int lightLayers = 16;           // height layers of the volume
+int lightSteps = 16;            // density samples towards the light per voxel
+float lightAbsorption = 2.0;    // extinction per unit of density and distance
+glm::vec3 bakedLightPos;        // light position of the last bake
+
+// light march of the cloud pass, density taps along a cone before reading the baked volume
+int lightTaps = 3;              // taps per lit sample, 0 to 6, set with '[' and ']'
+float lightTapLength = 0.3;     // length of the first tap segment, each next one is 1.5 times longer
+float lightTapThreshold = 0.55; // view ray density under which the taps are skipped
+float lightConeAngle = 0.3;     // cone radius per unit of distance from the sample
+
+// cloud transmittance along the light rays of the shadow camera, for cloud shadows on the scene
+GLuint cloudShadowProgram;
+GLuint cloudShadowFBO;
+GLuint cloudshadowtex;          // transmittance and light space depth where the clouds start
+int cloudShadowResolution = 512;
+int cloudShadowSteps = 32;      // density samples along each light ray
+
+// cloud ray marching
+float marchStepSize = 0.25;     // fine step length at the start of the ray
+float marchStepGrowth = 0.05;   // step length grows by this ratio every step
+float coarseStepRatio = 4.0;    // stride through empty space in fine steps
+float cloudExtinction = 1.6;    // extinction per unit of density and distance
+
+// cloud lighting, baked into lookup tables by buildCloudLuts(), set cloudLutsDirty after changing one
+glm::vec3 baseBright = glm::vec3(1.26, 1.25, 1.29);     // base color of thin cloud
+glm::vec3 baseDark = glm::vec3(0.31, 0.31, 0.32);       // base color of dense cloud
+glm::vec3 lightColor = glm::vec3(1.29, 1.17, 1.05);     // color of the direct light
+glm::vec3 ambientBottom = glm::vec3(0.42, 0.44, 0.5);   // ambient at the bottom of the slab
+glm::vec3 ambientTop = glm::vec3(0.64, 0.66, 0.72);     // ambient at the top of the slab
+float phaseForward = 0.6;       // henyey-greenstein g of the forward lobe
+float phaseBackward = -0.3;     // henyey-greenstein g of the backward lobe
+float phaseBlend = 0.7;         // weight of the forward lobe
+float phaseScale = 0.5;         // direct light relative to ambient for isotropic scattering
+GLuint phasetex;                // 1D phase times the light color over the cosine to the light
+GLuint basetex;                 // 1D base color over density
+GLuint ambienttex;              // 1D ambient color over the height in the slab
+int phaseLutSize = 256;
+int baseLutSize = 64;
+int ambientLutSize = 32;
+bool cloudLutsDirty = true;     // rebuild the lookup tables before the next frame
+
+// 'r' prints the error of the current march against a reference with many short steps
+bool cloudComparisonRequested = false;
+int referenceSteps = 1000;     // even steps of the reference over the whole cloud range of a ray
+
+// cloud slab, injected into the cloud shaders as #defines
+float cloudSlabBottom = 13;     // bottom of the cloud range
+float cloudSlabTop = 20;        // top of the cloud range
+float cloudSlabWidth = 100;     // xz range of the clouds [-width, width]
+float densityCut = 0.45;        // density below it is cut to zero
+
+// cloud quality tiers, selected with keys 1 to 3, constants are injected as #defines
+struct CloudQuality
+{
+    int marchSteps;             // max density samples per ray, jittered by blue noise
+    int octaves;                // fbm octaves of the coverage bake
+    float opacityThreshold;     // stop marching once the cloud is this opaque
+    int resolutionDivisor;      // cloud target is this many times smaller than the window
+};
+CloudQuality cloudQualities[3] = {
+    { 24, 4, 0.95, 4 },         // low
+    { 32, 5, 0.99, 2 },         // medium
+    { 64, 5, 0.995, 1 }         // high
+};
+int cloudQuality = 1;
+
+// clouds are marched at a fraction of the window resolution and upsampled by depth
+GLuint cloudProgram;
+GLuint cloudFBO;
+GLuint cloudtex;                // low resolution cloud color and opacity
+int cloudResolutionDivisor = 2; // 1, 2 or 4, set by the quality tier
+int cloudWidth, cloudHeight;    // cloud target size, set by resizeCloudTargets
+
+// temporal clouds, march one pixel of every 4x4 block per frame and reproject the rest
+bool temporalClouds = true;     // toggled by 't'
+GLuint reprojectProgram;
+GLuint marchFBO;
+GLuint marchtex;                // pixels marched this frame
+GLuint historyFBO[2];
+GLuint historytex[2];           // full cloud target, ping-pong between frames
+int historyIndex = 0;           // history written this frame
+glm::ivec2 historySize[2];      // size each history was allocated at, it follows the cloud target when written
+bool historyValid = false;
+glm::mat4 prevVP;               // camera view projection of the previous frame
+// 4x4 bayer order of the pixel marched in each block
+int bayerOffset[16][2] = {
+    {0, 0}, {2, 2}, {2, 0}, {0, 2}, {1, 1}, {3, 3}, {3, 1}, {1, 3},
+    {1, 0}, {3, 2}, {3, 0}, {1, 2}, {0, 1}, {2, 3}, {2, 1}, {0, 3}
+};
+
+// compute path of the cloud pass, 16x16 tiles are classified and each class gets its own kernel
+// needs GL 4.3, the fragment pass stays as the fallback
+bool computeSupported = false;
+bool computeClouds = false;     // toggled by 'c' when supported
+GLuint classifyProgram;         // writes empty tiles and lists the others by class
+GLuint cloudSkyProgram;         // kernel of the tiles that only see sky
+GLuint cloudComputeProgram;     // kernel of the tiles with scene occlusion
+GLuint tileBuffer;              // indirect dispatch arguments and tile lists of the classes
+int tileCapacity;               // tiles of the largest cloud output
+
+// near clouds and ground fog are integrated in a camera aligned froxel volume, needs the compute path
+bool froxelsEnabled = false;    // off by default, toggled by 'f' when compute is supported
+GLuint froxelProgram;           // scattered light and extinction per froxel
+GLuint froxelIntegrateProgram;  // front to back integration along the froxel columns
+GLuint froxelScattertex;        // scattered light and extinction
+GLuint froxeltex;               // in-scattered light and transmittance up to the end of each slice
+int froxelWidth = 160;
+int froxelHeight = 90;
+int froxelDepth = 64;           // exponential depth slices
+float froxelNear = 0.5;
+float froxelFar = 40.0;         // clouds past it are marched per pixel, at most panoramaDistance
+float fogDensity = 0.02;        // ground fog extinction at the ground
+float fogBase = -1.1;           // ground height
+float fogFalloff = 2.0;         // height above the ground where the fog is 1/e as dense
+glm::vec3 fogColor = glm::vec3(0.75, 0.8, 0.85);
+
+// distant clouds are marched into a low resolution panorama around the camera, a band per frame
+GLuint panoramaProgram;
+GLuint panoramaFBO;
+GLuint panoramatex;             // cube map of cloud color and opacity
+int panoramaResolution = 128;   // face width and height
+int panoramaBands = 4;          // a face is updated in this many bands of rows, one per frame
+int panoramaBand = 0;           // band updated next over all faces, the face is panoramaBand / panoramaBands
+bool panoramaReady = false;     // every face has been rendered once
+float panoramaDistance = 60.0;  // sky rays entering the clouds past this read the panorama
+
 // --------------- end of global variable definition --------------- //
 
 std::string readShaderFile(std::string filepath)
@@ -312,62 +520,638 @@ std::string readShaderFile(std::string filepath)
         std::cout << "SHADER FILE " << filepath << " FAIL TO OPEN" << std::endl;
         exit(-1);
     }
+    // included files are looked up relative to the current shader file
+    std::string rootPath = filepath.substr(0, filepath.find_last_of('/'));
     while (std::getline(fin, line))
     {
+        // paste the content of #include "file" in place
+        if (line.compare(0, 8, "#include") == 0)
+        {
+            std::string includePath = line.substr(line.find('"') + 1);
+            includePath = includePath.substr(0, includePath.find('"'));
+            res += readShaderFile(rootPath + '/' + includePath);
+            continue;
+        }
         res += line + '\n';
     }
     fin.close();
     return res;
 }
 
-GLuint getShaderProgram(std::string fshader, std::string vshader)
+// insert a #define block right after the #version line
+std::string injectDefines(std::string source, std::string defines)
+{
+    if (defines.empty()) return source;
+    size_t pos = source.compare(0, 8, "#version") == 0 ? source.find('\n') + 1 : 0;
+    return source.insert(pos, defines);
+}
+
+// read a shader stage, insert the defines and compile it, exits on compile errors
+GLuint compileShader(GLenum type, std::string path, std::string defines)
 {
-    // read shader source file
-    std::string vSource = readShaderFile(vshader);
-    std::string fSource = readShaderFile(fshader);
-    const char* vpointer = vSource.c_str();
-    const char* fpointer = fSource.c_str();
+    std::string source = injectDefines(readShaderFile(path), defines);
+    const char* pointer = source.c_str();
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, (const GLchar**)(&pointer), NULL);
+    glCompileShader(shader);
 
     GLint success;
     GLchar infoLog[512];
-
-    // create and compile vertex shaders
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, (const GLchar**)(&vpointer), NULL);
-    glCompileShader(vertexShader);
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);   // check errors
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);   // check errors
     if (!success)
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "VERTEX SHADER " + vshader + " COMPILED ERROR\n" << infoLog << std::endl;
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "SHADER " + path + " COMPILED ERROR\n" << infoLog << std::endl;
         exit(-1);
     }
+    return shader;
+}
 
-    // create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, (const GLchar**)(&fpointer), NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);   // check errors
-    if (!success)
-    {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "FRAGMENT " + fshader + " COMPILED ERROR\n" << infoLog << std::endl;
-        exit(-1);
-    }
+// program of the (type, path) stages with the defines inserted in every stage
+GLuint getProgram(std::vector<std::pair<GLenum, std::string>> stages, std::string defines)
+{
+    // one program per permutation, reused when the same defines come back
+    std::string key;
+    for (auto& stage : stages) key += stage.second + "|";
+    key += defines;
+    if (programCache.count(key)) return programCache[key];
 
-    // link two shaders to program
+    // compile and link the stages to program
     GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
+    std::vector<GLuint> shaders;
+    for (auto& stage : stages)
+    {
+        shaders.push_back(compileShader(stage.first, stage.second, defines));
+        glAttachShader(shaderProgram, shaders.back());
+    }
     glLinkProgram(shaderProgram);
 
     // delete after linking
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    for (GLuint shader : shaders) glDeleteShader(shader);
 
+    programCache[key] = shaderProgram;
     return shaderProgram;
 }
 
+GLuint getShaderProgram(std::string fshader, std::string vshader, std::string defines = "")
+{
+    return getProgram({ { GL_VERTEX_SHADER, vshader }, { GL_FRAGMENT_SHADER, fshader } }, defines);
+}
+
+GLuint getComputeProgram(std::string cshader, std::string defines = "")
+{
+    return getProgram({ { GL_COMPUTE_SHADER, cshader } }, defines);
+}
+
+// ------------------------------------------------------------------------ // 
+// tileable 3D noise volumes
+
+// integer hash of a lattice cell, wrapped by the period so the volume tiles
+unsigned int hashCell(int x, int y, int z, int period, unsigned int seed)
+{
+    x = (x % period + period) % period;
+    y = (y % period + period) % period;
+    z = (z % period + period) % period;
+    unsigned int h = seed * 2654435761u ^ x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// gradient noise in about [-1, 1], one lattice cell per unit
+float perlinNoise(glm::vec3 p, int period, unsigned int seed)
+{
+    static const glm::vec3 gradients[12] = {
+        glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, -1, 0), glm::vec3(-1, -1, 0),
+        glm::vec3(1, 0, 1), glm::vec3(-1, 0, 1), glm::vec3(1, 0, -1), glm::vec3(-1, 0, -1),
+        glm::vec3(0, 1, 1), glm::vec3(0, -1, 1), glm::vec3(0, 1, -1), glm::vec3(0, -1, -1)
+    };
+    glm::vec3 cell = glm::floor(p);
+    glm::vec3 f = p - cell;
+    glm::vec3 u = f * f * f * (f * (f * 6.0f - 15.0f) + 10.0f);
+
+    // dot products of the eight corner gradients, blended trilinearly
+    float corner[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 offset(i & 1, (i >> 1) & 1, i >> 2);
+        glm::vec3 c = cell + offset;
+        corner[i] = glm::dot(gradients[hashCell(int(c.x), int(c.y), int(c.z), period, seed) % 12], f - offset);
+    }
+    float y0 = glm::mix(glm::mix(corner[0], corner[1], u.x), glm::mix(corner[2], corner[3], u.x), u.y);
+    float y1 = glm::mix(glm::mix(corner[4], corner[5], u.x), glm::mix(corner[6], corner[7], u.x), u.y);
+    return glm::mix(y0, y1, u.z);
+}
+
+// inverted cellular noise in [0, 1], one feature point per lattice cell
+float worleyNoise(glm::vec3 p, int period, unsigned int seed)
+{
+    glm::vec3 cell = glm::floor(p);
+    float minDist = 1.0f;
+    for (int z = -1; z <= 1; z++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                glm::vec3 c = cell + glm::vec3(x, y, z);
+                unsigned int h = hashCell(int(c.x), int(c.y), int(c.z), period, seed);
+                glm::vec3 feature = c + glm::vec3(h & 0x3ff, (h >> 10) & 0x3ff, (h >> 20) & 0x3ff) / 1023.0f;
+                minDist = glm::min(minDist, glm::length(feature - p));
+            }
+        }
+    }
+    return 1.0f - minDist;
+}
+
+// worley fbm of three octaves starting at frequency cells per tile
+float worleyFbm(glm::vec3 p, int frequency, unsigned int seed)
+{
+    return worleyNoise(p * float(frequency), frequency, seed) * 0.625f
+        + worleyNoise(p * float(frequency * 2), frequency * 2, seed) * 0.25f
+        + worleyNoise(p * float(frequency * 4), frequency * 4, seed) * 0.125f;
+}
+
+// size^2 texels of a 2D tile or size^3 voxels of a volume, tiling in every axis, rows are spread
+// over all cpu threads, only the channel the shaders sample is generated
+// shape: perlin-worley on the middle slice of a tileable volume
+// detail: worley fbm
+std::vector<unsigned char> generateNoise(int size, int depth, bool shape, int frequency, unsigned int seed)
+{
+    std::vector<float> values(size * size * depth);
+    auto generateRows = [&](int first, int stride) {
+        for (int row = first; row < size * depth; row += stride) {
+            int y = row % size, z = row / size;
+            for (int x = 0; x < size; x++) {
+                glm::vec3 p = glm::vec3(x + 0.5f, y + 0.5f, depth == 1 ? size * 0.5f : z + 0.5f) / float(size);
+                float value;
+                if (shape) {
+                    // perlin fbm remapped by worley fbm gives billowy shapes
+                    float perlin = 0.0f, amplitude = 0.5f;
+                    for (int octave = 0; octave < 4; octave++) {
+                        int f = frequency << octave;
+                        perlin += amplitude * perlinNoise(p * float(f), f, seed);
+                        amplitude *= 0.5f;
+                    }
+                    perlin = glm::clamp(perlin * 0.5f + 0.5f, 0.0f, 1.0f);
+                    float worley = worleyFbm(p, frequency, seed + 1);
+                    value = glm::clamp((perlin - (worley - 1.0f)) / (2.0f - worley), 0.0f, 1.0f);
+                } else {
+                    value = worleyFbm(p, frequency, seed + 2);
+                }
+                values[row * size + x] = value;
+            }
+        }
+    };
+    int threadCount = std::max(1, int(std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++) {
+        threads.push_back(std::thread(generateRows, i, threadCount));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // stretch to the full 8 bit range
+    float low = *std::min_element(values.begin(), values.end());
+    float high = *std::max_element(values.begin(), values.end());
+    std::vector<unsigned char> texels(values.size());
+    for (size_t v = 0; v < values.size(); v++) {
+        texels[v] = (unsigned char)((values[v] - low) / std::max(high - low, 1e-6f) * 255.0f + 0.5f);
+    }
+    return texels;
+}
+
+// load a noise texture from the cache file keyed on its parameters, generate and cache it if missing
+// depth 1 makes a 2D texture, anything else a volume; bump noiseVersion when the generator changes
+GLuint loadNoiseTexture(std::string name, int size, int depth, bool shape, int frequency, unsigned int seed)
+{
+    std::ostringstream path;
+    path << "cache/" << name << "_v" << noiseVersion << "_" << size << "_" << depth << "_" << frequency << "_" << seed << ".bin";
+
+    std::vector<unsigned char> texels(size * size * depth);
+    std::ifstream fin(path.str(), std::ios::binary);
+    if (!fin.read((char*)texels.data(), texels.size()))
+    {
+        std::cout << "GENERATE NOISE " << path.str() << std::endl;
+        texels = generateNoise(size, depth, shape, frequency, seed);
+        std::ofstream fout(path.str(), std::ios::binary);
+        if (!fout.write((char*)texels.data(), texels.size()))
+        {
+            std::cout << "NOISE CACHE " << path.str() << " FAIL TO WRITE" << std::endl;
+        }
+    }
+
+    GLenum target = depth == 1 ? GL_TEXTURE_2D : GL_TEXTURE_3D;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (depth == 1) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, size, size, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+    } else {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, size, size, depth, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(target);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    return texture;
+}
+
+// henyey-greenstein phase function, integrates to 1 over the sphere
+float henyeyGreenstein(float cosTheta, float g)
+{
+    float denom = 1.0f + g * g - 2.0f * g * cosTheta;
+    return (1.0f - g * g) / (4.0f * glm::pi<float>() * denom * std::sqrt(denom));
+}
+
+// fill the cloud lighting lookup tables from the lighting parameters
+void buildCloudLuts()
+{
+    // dual-lobe phase times the light color, scaled so isotropic scattering gives phaseScale
+    std::vector<glm::vec3> phase(phaseLutSize);
+    for (int i = 0; i < phaseLutSize; i++) {
+        float cosTheta = float(i) / (phaseLutSize - 1) * 2.0f - 1.0f;
+        float p = glm::mix(henyeyGreenstein(cosTheta, phaseBackward), henyeyGreenstein(cosTheta, phaseForward), phaseBlend);
+        phase[i] = lightColor * p * 4.0f * glm::pi<float>() * phaseScale;
+    }
+    glBindTexture(GL_TEXTURE_1D, phasetex);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB16F, phaseLutSize, 0, GL_RGB, GL_FLOAT, phase.data());
+
+    // base color darkens with density
+    std::vector<glm::vec3> base(baseLutSize);
+    for (int i = 0; i < baseLutSize; i++) {
+        base[i] = glm::mix(baseBright, baseDark, float(i) / (baseLutSize - 1) * 0.5f);
+    }
+    glBindTexture(GL_TEXTURE_1D, basetex);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB16F, baseLutSize, 0, GL_RGB, GL_FLOAT, base.data());
+
+    // sky light reaches the top of the slab more than its bottom
+    std::vector<glm::vec3> ambient(ambientLutSize);
+    for (int i = 0; i < ambientLutSize; i++) {
+        ambient[i] = glm::mix(ambientBottom, ambientTop, float(i) / (ambientLutSize - 1));
+    }
+    glBindTexture(GL_TEXTURE_1D, ambienttex);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB16F, ambientLutSize, 0, GL_RGB, GL_FLOAT, ambient.data());
+}
+
+// ------------------------------------------------------------------------ // 
+// cloud quality
+
+// #define block of the cloud slab and a quality tier
+std::string getCloudDefines(const CloudQuality& quality)
+{
+    std::ostringstream defines;
+    defines << std::fixed;
+    defines << "#define bottom " << cloudSlabBottom << "\n";
+    defines << "#define top " << cloudSlabTop << "\n";
+    defines << "#define width " << cloudSlabWidth << "\n";
+    defines << "#define densityCut " << densityCut << "\n";
+    defines << "#define MARCH_STEPS " << quality.marchSteps << "\n";
+    defines << "#define NUM_OCTAVES " << quality.octaves << "\n";
+    defines << "#define OPACITY_THRESHOLD " << quality.opacityThreshold << "\n";
+    return defines.str();
+}
+
+// cloud programs of the current quality tier, compiled on first use
+void loadCloudPrograms()
+{
+    std::string defines = getCloudDefines(cloudQualities[cloudQuality]);
+    coverageProgram = getShaderProgram("shaders/coverage.fs", "shaders/composite0.vs", defines);
+    extentProgram = getShaderProgram("shaders/extent.fs", "shaders/composite0.vs", defines);
+    opacityProgram = getShaderProgram("shaders/opacity.fs", "shaders/composite0.vs", defines);
+    lightingProgram = getShaderProgram("shaders/lighting.fs", "shaders/composite0.vs", defines);
+    cloudShadowProgram = getShaderProgram("shaders/cloudshadow.fs", "shaders/composite0.vs", defines);
+    cloudProgram = getShaderProgram("shaders/cloud.fs", "shaders/composite0.vs", defines);
+    reprojectProgram = getShaderProgram("shaders/reproject.fs", "shaders/composite0.vs", defines);
+    panoramaProgram = getShaderProgram("shaders/panorama.fs", "shaders/composite0.vs", defines);
+    if (computeSupported) {
+        classifyProgram = getComputeProgram("shaders/classify.comp", defines);
+        cloudSkyProgram = getComputeProgram("shaders/cloud.comp", defines + "#define SKY_TILES\n");
+        cloudComputeProgram = getComputeProgram("shaders/cloud.comp", defines);
+        froxelProgram = getComputeProgram("shaders/froxel.comp", defines);
+        froxelIntegrateProgram = getComputeProgram("shaders/froxelintegrate.comp", defines);
+    }
+}
+
+// (re)allocate the cloud targets for the window size, cloud scale and resolution divisor
+void resizeCloudTargets()
+{
+    cloudWidth = std::max(int(windowWidth * cloudScale) / cloudResolutionDivisor, 1);
+    cloudHeight = std::max(int(windowHeight * cloudScale) / cloudResolutionDivisor, 1);
+    glBindTexture(GL_TEXTURE_2D, cloudtex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, cloudWidth, cloudHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D, marchtex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, (cloudWidth + 3) / 4, (cloudHeight + 3) / 4, 0, GL_RGBA, GL_FLOAT, NULL);
+    // the histories follow when they are next written, the one read is sampled by screen coord
+    // so it stays valid at its old size
+
+    // tile lists hold every tile of the full cloud target twice, once per class
+    if (computeSupported) {
+        tileCapacity = ((cloudWidth + 15) / 16) * ((cloudHeight + 15) / 16);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (6 + 2 * tileCapacity) * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    }
+}
+
+// (re)allocate the gbuffer, Hi-Z and composited frame for the window size and render scale
+void resizeRenderTargets()
+{
+    renderWidth = std::max(int(windowWidth * renderScale), 1);
+    renderHeight = std::max(int(windowHeight * renderScale), 1);
+
+    // sRGB keeps the precision of 8 bits in the dark tones, normals are octahedral encoded in two channels
+    // the compact formats are not renderable everywhere, fall back to the plain ones when incomplete
+    glBindFramebuffer(GL_FRAMEBUFFER, gbufferFBO);
+    for (;;) {
+        glBindTexture(GL_TEXTURE_2D, gcolor);
+        glTexImage2D(GL_TEXTURE_2D, 0, compactGBuffer ? GL_SRGB8_ALPHA8 : GL_RGBA8, renderWidth, renderHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+        glBindTexture(GL_TEXTURE_2D, gnormal);
+        glTexImage2D(GL_TEXTURE_2D, 0, compactGBuffer ? GL_RG16_SNORM : GL_RG32F, renderWidth, renderHeight, 0, GL_RG, GL_FLOAT, NULL);
+        glBindTexture(GL_TEXTURE_2D, gdepth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, renderWidth, renderHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        if (!compactGBuffer || glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+            break;
+        }
+        std::cout << "compact gbuffer is incomplete, using RGBA8 color and RG32F normal" << std::endl;
+        compactGBuffer = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Hi-Z with a full mip chain
+    glBindTexture(GL_TEXTURE_2D, hiztex);
+    for (hizLevels = 0; (std::max(renderWidth, renderHeight) >> hizLevels) > 0; hizLevels++) {
+        int width = std::max(renderWidth >> hizLevels, 1);
+        int height = std::max(renderHeight >> hizLevels, 1);
+        glTexImage2D(GL_TEXTURE_2D, hizLevels, GL_RG32F, width, height, 0, GL_RG, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, hizLevels - 1);
+
+    glBindTexture(GL_TEXTURE_2D, scenetex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, renderWidth, renderHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+}
+
+// window resized, the camera aspect and every screen sized target follow
+void reshape(int width, int height)
+{
+    windowWidth = std::max(width, 1);
+    windowHeight = std::max(height, 1);
+    camera.aspect = float(windowWidth) / windowHeight;
+    resizeRenderTargets();
+    resizeCloudTargets();
+}
+
+// issue a gpu timestamp of this frame
+void writeTimestamp(int stamp)
+{
+    glQueryCounter(timerQueries[timerFrame % timerFrames][stamp], GL_TIMESTAMP);
+}
+
+// move a scale one step towards the scale that fits its budget, down only when it is clearly
+// over and up only when a whole step fits, so a budget near the scale does not flip it
+float stepScale(float scale, float target, float minScale)
+{
+    if (target < scale - scaleHysteresis) {
+        return std::max(scale - scaleStep, minScale);
+    }
+    if (target >= scale + scaleStep) {
+        return std::min(scale + scaleStep, 1.0f);
+    }
+    return scale;
+}
+
+// pick the render and cloud scales that hold targetFrameTime, from the timestamps of the
+// oldest frame of the ring before its queries are reused, averaged over timerAverageFrames
+void updateDynamicResolution()
+{
+    GLuint* queries = timerQueries[timerFrame % timerFrames];
+    GLint available = 0;
+    if (timerFrame >= timerFrames) {
+        glGetQueryObjectiv(queries[STAMP_FRAME_END], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if (!available) {
+        return;
+    }
+    GLuint64 stamps[STAMPS];
+    for (int i = 0; i < STAMPS; i++) {
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &stamps[i]);
+    }
+    auto elapsed = [&](int begin, int end) { return (stamps[end] - stamps[begin]) / 1e6f; };
+    float sceneTime = elapsed(STAMP_GBUFFER_BEGIN, STAMP_GBUFFER_END) + elapsed(STAMP_CLOUD_END, STAMP_COMPOSITE_END);
+    float cloudTime = elapsed(STAMP_CLOUD_BEGIN, STAMP_CLOUD_END);
+    float fixedTime = elapsed(STAMP_FRAME_BEGIN, STAMP_FRAME_END) - sceneTime - cloudTime;
+
+    // both passes cost about their pixel count, so their time at full resolution is
+    // the measured one over the square of the scale they were drawn at
+    float* scales = timerScales[timerFrame % timerFrames];
+    timerSums[0] += sceneTime / (scales[0] * scales[0]);
+    timerSums[1] += cloudTime / (scales[1] * scales[1]);
+    timerSums[2] += fixedTime;
+    if (++timerSamples < timerAverageFrames) {
+        return;
+    }
+    float sceneFull = timerSums[0] / timerSamples;
+    float cloudFull = std::max(timerSums[1] / timerSamples, 0.001f);
+    float budget = std::max(targetFrameTime - timerSums[2] / timerSamples, 0.0f);
+    timerSums[0] = timerSums[1] = timerSums[2] = 0.0f;
+    timerSamples = 0;
+
+    // the same area ratio for both, once the gbuffer stops at its minimum the clouds take the rest
+    float renderArea = glm::clamp(budget / (sceneFull + cloudFull), minRenderScale * minRenderScale, 1.0f);
+    float cloudArea = glm::clamp((budget - sceneFull * renderArea) / cloudFull, minCloudScale * minCloudScale, 1.0f);
+
+    float newRenderScale = stepScale(renderScale, std::sqrt(renderArea), minRenderScale);
+    float newCloudScale = stepScale(cloudScale, std::sqrt(cloudArea), minCloudScale);
+    if (newRenderScale != renderScale) {
+        renderScale = newRenderScale;
+        resizeRenderTargets();
+    }
+    if (newCloudScale != cloudScale) {
+        cloudScale = newCloudScale;
+        resizeCloudTargets();
+    }
+}
+
+void setCloudQuality(int quality)
+{
+    cloudQuality = quality;
+    loadCloudPrograms();
+    if (cloudResolutionDivisor != cloudQualities[quality].resolutionDivisor) {
+        cloudResolutionDivisor = cloudQualities[quality].resolutionDivisor;
+        resizeCloudTargets();
+    }
+    cloudBaked = false;     // octaves may have changed
+    panoramaBand = 0;       // march steps may have changed
+    panoramaReady = false;
+}
+
+// build every level of a min/max pyramid from its top level
+void reducePyramid(GLuint fbo, GLuint texture, int width, int height, int levels)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUseProgram(reduceProgram);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(glGetUniformLocation(reduceProgram, "pyramidtex"), 1);
+    for (int level = 1; level < levels; level++) {
+        // only the level read is visible to sampling, so the level written does not feed back
+        // screen.draw leaves unit 0 active, the parameters are for the pyramid on unit 1
+        glActiveTexture(GL_TEXTURE1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        glViewport(0, 0, std::max(width >> level, 1), std::max(height >> level, 1));
+
+        screen.draw(reduceProgram);
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+}
+
+// bind the baked cloud textures and march parameters shared by the cloud and panorama passes
+void bindCloudMarchInputs(GLuint program)
+{
+    // pass cloud coverage texture
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, coveragetex);
+    glUniform1i(glGetUniformLocation(program, "coveragetex"), 2);
+    // pass cloud extent texture
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, extenttex);
+    glUniform1i(glGetUniformLocation(program, "extenttex"), 3);
+    glUniform1i(glGetUniformLocation(program, "extentLevels"), extentLevels);
+    // pass blue noise texture
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, noisetex);
+    glUniform1i(glGetUniformLocation(program, "noisetex"), 6);
+    // pass light transmittance volume
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_3D, lighttex);
+    glUniform1i(glGetUniformLocation(program, "lighttex"), 4);
+    // pass detail noise volume
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_3D, detailtex);
+    glUniform1i(glGetUniformLocation(program, "detailtex"), 5);
+
+    // pass camera position
+    glUniform3fv(glGetUniformLocation(program, "cameraPos"), 1, glm::value_ptr(camera.position));
+
+    // pass ray marching parameter
+    glUniform1f(glGetUniformLocation(program, "marchStepSize"), marchStepSize);
+    glUniform1f(glGetUniformLocation(program, "marchStepGrowth"), marchStepGrowth);
+    glUniform1f(glGetUniformLocation(program, "coarseStepRatio"), coarseStepRatio);
+    glUniform1f(glGetUniformLocation(program, "cloudExtinction"), cloudExtinction);
+
+    // pass lighting lookup tables
+    glActiveTexture(GL_TEXTURE9);
+    glBindTexture(GL_TEXTURE_1D, phasetex);
+    glUniform1i(glGetUniformLocation(program, "phasetex"), 9);
+    glActiveTexture(GL_TEXTURE10);
+    glBindTexture(GL_TEXTURE_1D, basetex);
+    glUniform1i(glGetUniformLocation(program, "basetex"), 10);
+    glActiveTexture(GL_TEXTURE11);
+    glBindTexture(GL_TEXTURE_1D, ambienttex);
+    glUniform1i(glGetUniformLocation(program, "ambienttex"), 11);
+    glActiveTexture(GL_TEXTURE12);
+    glBindTexture(GL_TEXTURE_2D, opacitytex);
+    glUniform1i(glGetUniformLocation(program, "opacitytex"), 12);
+    glUniform1f(glGetUniformLocation(program, "ambientAbsorption"), ambientAbsorption);
+    glUniform3fv(glGetUniformLocation(program, "lightPos"), 1, glm::value_ptr(shadowCamera.position));
+
+    // pass light march parameter
+    glUniform1i(glGetUniformLocation(program, "lightTaps"), lightTaps);
+    glUniform1f(glGetUniformLocation(program, "lightTapLength"), lightTapLength);
+    glUniform1f(glGetUniformLocation(program, "lightTapThreshold"), lightTapThreshold);
+    glUniform1f(glGetUniformLocation(program, "lightConeAngle"), lightConeAngle);
+    glUniform1f(glGetUniformLocation(program, "lightAbsorption"), lightAbsorption);
+}
+
+// march every pixel of the cloud target with a program and step settings, and read it back
+std::vector<float> marchCloudImage(GLuint program, float stepSize, float stepGrowth, int noiseSlice, const glm::mat4& inverseVP, float pixelAngle)
+{
+    int width = cloudWidth;
+    int height = cloudHeight;
+
+    // float target so the error is not hidden by rounding
+    GLuint fbo, texture;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    glUseProgram(program);
+    glViewport(0, 0, width, height);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, gdepth);
+    glUniform1i(glGetUniformLocation(program, "gdepth"), 1);
+    bindCloudMarchInputs(program);
+    glUniform1f(glGetUniformLocation(program, "marchStepSize"), stepSize);
+    glUniform1f(glGetUniformLocation(program, "marchStepGrowth"), stepGrowth);
+    glUniform1i(glGetUniformLocation(program, "panoramaReady"), false);
+    glUniformMatrix4fv(glGetUniformLocation(program, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
+    glUniform2f(glGetUniformLocation(program, "cloudSize"), width, height);
+    glUniform1i(glGetUniformLocation(program, "cloudBlock"), 1);
+    glUniform2i(glGetUniformLocation(program, "cloudOffset"), 0, 0);
+    glUniform1i(glGetUniformLocation(program, "noiseSlice"), noiseSlice);
+    glUniform1f(glGetUniformLocation(program, "pixelAngle"), pixelAngle);
+    glUniform1f(glGetUniformLocation(program, "marchStart"), 0.0);
+
+    screen.draw(program);
+
+    std::vector<float> pixels(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, pixels.data());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    return pixels;
+}
+
+// error of the current tier and step settings against a plain march with referenceSteps even steps
+void compareCloudReference(const glm::mat4& inverseVP, float pixelAngle)
+{
+    CloudQuality reference = cloudQualities[cloudQuality];
+    reference.marchSteps = referenceSteps;
+    reference.opacityThreshold = 0.9999;
+    std::string defines = getCloudDefines(reference) + "#define REFERENCE_MARCH\n";
+    // the permutation stays in the program cache, later comparisons reuse it
+    GLuint referenceProgram = getShaderProgram("shaders/cloud.fs", "shaders/composite0.vs", defines);
+
+    // the march is averaged over every blue noise slice as the temporal accumulation does, so the
+    // error is the bias of the march and not the noise of its jitter
+    std::vector<float> image;
+    for (int slice = 0; slice < noiseSlices; slice++) {
+        std::vector<float> pixels = marchCloudImage(cloudProgram, marchStepSize, marchStepGrowth, slice, inverseVP, pixelAngle);
+        image.resize(pixels.size());
+        for (size_t i = 0; i < pixels.size(); i++) {
+            image[i] += pixels[i] / noiseSlices;
+        }
+    }
+    std::vector<float> target = marchCloudImage(referenceProgram, marchStepSize, marchStepGrowth, 0, inverseVP, pixelAngle);
+
+    // premultiplied color and opacity, in [0, 1]
+    double sum = 0.0, maxError = 0.0;
+    for (size_t i = 0; i < image.size(); i++) {
+        double error = image[i] - target[i];
+        sum += error * error;
+        maxError = std::max(maxError, std::abs(error));
+    }
+    std::cout << "cloud march " << cloudQualities[cloudQuality].marchSteps << " steps against "
+              << referenceSteps << " step reference: rmse " << std::sqrt(sum / image.size())
+              << " max " << maxError << std::endl;
+}
+
 void mouseWheel(int wheel, int direction, int x, int y)
 {
     // zFar += 1 * direction * 0.1;
@@ -389,6 +1173,46 @@ void mouse(int x, int y)
 
 void keyboardDown(unsigned char key, int x, int y)
 {
+    // switch temporal clouds once per press, history is stale after switching
+    if (key == 't' && !keyboardState[key]) {
+        temporalClouds = !temporalClouds;
+        historyValid = false;
+    }
+    // switch between the compute and fragment cloud pass
+    if (key == 'c' && !keyboardState[key] && computeSupported) {
+        computeClouds = !computeClouds;
+    }
+    // measure the march error once per press
+    if (key == 'r' && !keyboardState[key]) {
+        cloudComparisonRequested = true;
+    }
+    // light march budget, separate from the march steps of the tier
+    if (key == '[' && lightTaps > 0) {
+        lightTaps--;
+    }
+    if (key == ']' && lightTaps < 6) {
+        lightTaps++;
+    }
+    // switch the froxel volume for near clouds and fog
+    if (key == 'f' && !keyboardState[key] && computeSupported) {
+        froxelsEnabled = !froxelsEnabled;
+    }
+    // switch dynamic resolution, back to full resolution when it is off
+    if (key == 'v' && !keyboardState[key]) {
+        dynamicResolution = !dynamicResolution;
+        timerSums[0] = timerSums[1] = timerSums[2] = 0.0f;
+        timerSamples = 0;
+        if (!dynamicResolution) {
+            renderScale = 1.0;
+            cloudScale = 1.0;
+            resizeRenderTargets();
+            resizeCloudTargets();
+        }
+    }
+    // switch cloud quality tier once per press, the programs are only rebuilt for a new tier
+    if (key >= '1' && key <= '3' && !keyboardState[key] && key - '1' != cloudQuality) {
+        setCloudQuality(key - '1');
+    }
     keyboardState[key] = true;
 }
 void keyboardDownSpecial(int key, int x, int y)
@@ -461,6 +1285,12 @@ void init()
     debugProgram = getShaderProgram("shaders/debug.fs", "shaders/debug.vs");
     skyboxProgram = getShaderProgram("shaders/skybox.fs", "shaders/skybox.vs");
     composite0 = getShaderProgram("shaders/composite0.fs", "shaders/composite0.vs");
+    reduceProgram = getShaderProgram("shaders/reduce.fs", "shaders/composite0.vs");
+    hizProgram = getShaderProgram("shaders/hiz.fs", "shaders/composite0.vs");
+    upscaleProgram = getShaderProgram("shaders/upscale.fs", "shaders/composite0.vs");
+    computeSupported = GLEW_VERSION_4_3;
+    computeClouds = computeSupported;
+    loadCloudPrograms();
 
     // ------------------------------------------------------------------------ // 
 
@@ -558,10 +1388,9 @@ void init()
     glGenFramebuffers(1, &gbufferFBO); 
     glBindFramebuffer(GL_FRAMEBUFFER, gbufferFBO);
 
-    // create color texture
+    // create color texture, sized later
     glGenTextures(1, &gcolor);
     glBindTexture(GL_TEXTURE_2D, gcolor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -569,10 +1398,9 @@ void init()
     // bind color texture to color attachment 0 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gcolor, 0);
 
-    // create normal texture
+    // create normal texture, sized later
     glGenTextures(1, &gnormal);
     glBindTexture(GL_TEXTURE_2D, gnormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -580,21 +1408,9 @@ void init()
     // bind normal texture to color attachment 1 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gnormal, 0);
 
-    // create world position texture
-    glGenTextures(1, &gworldpos);
-    glBindTexture(GL_TEXTURE_2D, gworldpos);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    // bind world position to color attachment 2 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gworldpos, 0);
-
-    // create depth texture
+    // create depth texture, sized later
     glGenTextures(1, &gdepth);
     glBindTexture(GL_TEXTURE_2D, gdepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, windowWidth, windowHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -602,12 +1418,256 @@ void init()
     // bind depth texture to depth attachment
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gdepth, 0);
 
-    GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
+    // world positions are rebuilt from gdepth
+    GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);	
 
     // ------------------------------------------------------------------------ // 
 
+    // load blue noise slices made offline by tools/bluenoise.cpp
+    int noiseWidth, noiseHeight;
+    unsigned char* noiseImage = SOIL_load_image("textures/bluenoise.bmp", &noiseWidth, &noiseHeight, 0, SOIL_LOAD_RGB);
+    glGenTextures(1, &noisetex);
+    glBindTexture(GL_TEXTURE_2D, noisetex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, noiseWidth, noiseHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, noiseImage);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    SOIL_free_image_data(noiseImage);
+
+    // load cloud noise volumes, generated on the first run
+    shapetex = loadNoiseTexture("shape", shapeResolution, 1, true, shapeFrequency, noiseSeed);
+    detailtex = loadNoiseTexture("detail", detailResolution, detailResolution, false, detailFrequency, noiseSeed);
+
+    // create cloud lighting lookup tables, filled by buildCloudLuts in the first frame
+    GLuint luts[3];
+    glGenTextures(3, luts);
+    phasetex = luts[0];
+    basetex = luts[1];
+    ambienttex = luts[2];
+    for (GLuint lut : luts) {
+        glBindTexture(GL_TEXTURE_1D, lut);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    }
+
+    // ------------------------------------------------------------------------ //
+
+    // create cloud coverage frame buffer object
+    glGenFramebuffers(1, &coverageFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, coverageFBO);
+
+    // create coverage texture, linear filtered so the march gets a bilinear fetch, and mipmapped
+    // so distant samples read a level matching their footprint
+    glGenTextures(1, &coveragetex);
+    glBindTexture(GL_TEXTURE_2D, coveragetex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, coverageResolution, coverageResolution, 0, GL_RED, GL_FLOAT, NULL);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind coverage texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, coveragetex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create cloud extent frame buffer object
+    glGenFramebuffers(1, &extentFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, extentFBO);
+
+    // create extent texture with a full mip chain, fetched per texel so no filtering
+    int extentResolution = coverageResolution / extentCellSize;
+    glGenTextures(1, &extenttex);
+    glBindTexture(GL_TEXTURE_2D, extenttex);
+    for (extentLevels = 0; (extentResolution >> extentLevels) > 0; extentLevels++) {
+        int size = extentResolution >> extentLevels;
+        glTexImage2D(GL_TEXTURE_2D, extentLevels, GL_RG32F, size, size, 0, GL_RG, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, extentLevels - 1);
+    // a mipmap min filter, texelFetch of the levels above the base is undefined without one
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind extent texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, extenttex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create vertical opacity frame buffer object
+    glGenFramebuffers(1, &opacityFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, opacityFBO);
+
+    // create vertical opacity texture, linear filtered like the coverage it is integrated from
+    glGenTextures(1, &opacitytex);
+    glBindTexture(GL_TEXTURE_2D, opacitytex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, opacityResolution, opacityResolution, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind vertical opacity texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, opacitytex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create Hi-Z frame buffer object
+    glGenFramebuffers(1, &hizFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, hizFBO);
+
+    // create Hi-Z texture, fetched per texel so no filtering, sized later
+    // a mipmap min filter, texelFetch of the levels above the base is undefined without one
+    glGenTextures(1, &hiztex);
+    glBindTexture(GL_TEXTURE_2D, hiztex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind Hi-Z texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, hiztex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create light transmittance frame buffer object
+    glGenFramebuffers(1, &lightingFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightingFBO);
+
+    // create light transmittance volume, one layer is rendered per pass
+    glGenTextures(1, &lighttex);
+    glBindTexture(GL_TEXTURE_3D, lighttex);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, lightResolution, lightResolution, lightLayers, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // bind the first layer to color attachment 0
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, lighttex, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create cloud shadow frame buffer object
+    glGenFramebuffers(1, &cloudShadowFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, cloudShadowFBO);
+
+    // create cloud shadow texture
+    glGenTextures(1, &cloudshadowtex);
+    glBindTexture(GL_TEXTURE_2D, cloudshadowtex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, cloudShadowResolution, cloudShadowResolution, 0, GL_RG, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind cloud shadow texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cloudshadowtex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create cloud frame buffer object
+    glGenFramebuffers(1, &cloudFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, cloudFBO);
+
+    // create cloud texture, fetched per texel by the depth aware upsample, sized later
+    glGenTextures(1, &cloudtex);
+    glBindTexture(GL_TEXTURE_2D, cloudtex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind cloud texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cloudtex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create temporal cloud march frame buffer object, one texel per 4x4 block
+    glGenFramebuffers(1, &marchFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, marchFBO);
+
+    // create march texture, sized later
+    glGenTextures(1, &marchtex);
+    glBindTexture(GL_TEXTURE_2D, marchtex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind march texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, marchtex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create cloud history frame buffer objects
+    glGenFramebuffers(2, historyFBO);
+    glGenTextures(2, historytex);
+    for (int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFBO[i]);
+
+        // create history texture, linear filtered for reprojection, sized later
+        glBindTexture(GL_TEXTURE_2D, historytex[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // bind history texture to color attachment 0
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, historytex[i], 0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create froxel volumes, written as images by the compute path
+    if (computeSupported) {
+        GLuint froxels[2];
+        glGenTextures(2, froxels);
+        froxelScattertex = froxels[0];
+        froxeltex = froxels[1];
+        for (int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_3D, froxels[i]);
+            glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, froxelWidth, froxelHeight, froxelDepth, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        }
+    }
+
+    // create tile buffer of the compute path, sized with the cloud targets
+    glGenBuffers(1, &tileBuffer);
+
+    // create composited frame buffer object, upscaled to the window when the gbuffer is scaled
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+
+    // create composited frame texture, linear filtered for the upscale, sized later
+    glGenTextures(1, &scenetex);
+    glBindTexture(GL_TEXTURE_2D, scenetex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // bind composited frame texture to color attachment 0
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scenetex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // create timestamp queries of the dynamic resolution controller
+    glGenQueries(timerFrames * STAMPS, &timerQueries[0][0]);
+
+    // allocate the screen sized targets for the window
+    resizeRenderTargets();
+    resizeCloudTargets();
+
+    // create panorama framebuffer, the face is attached when it is rendered
+    glGenFramebuffers(1, &panoramaFBO);
+
+    // create panorama cube map, faces are filtered together across their edges
+    glGenTextures(1, &panoramatex);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, panoramatex);
+    for (int i = 0; i < 6; i++) {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA16F, panoramaResolution, panoramaResolution, 0, GL_RGBA, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    // ------------------------------------------------------------------------ //
+
     glEnable(GL_DEPTH_TEST);  // enable depth test
     glClearColor(1.0, 1.0, 1.0, 1.0);   // background color
 }
@@ -616,6 +1676,13 @@ void display()
 {
     move(); // control camera position
 
+    if (dynamicResolution) {
+        updateDynamicResolution();
+    }
+    timerScales[timerFrame % timerFrames][0] = renderScale;
+    timerScales[timerFrame % timerFrames][1] = cloudScale;
+    writeTimestamp(STAMP_FRAME_BEGIN);
+
     // the last object will be the light source 
     models.back().translate = shadowCamera.position + glm::vec3(0, 0, 2);
 
@@ -643,11 +1710,15 @@ void display()
     // ------------------------------------------------------------------------ // 
 
     // skybox drawing
-    // pass to three textures of gbuffer
+    // pass to two textures of gbuffer
+    writeTimestamp(STAMP_GBUFFER_BEGIN);
     glUseProgram(skyboxProgram);
     glBindFramebuffer(GL_FRAMEBUFFER, gbufferFBO);
+    if (compactGBuffer) {
+        glEnable(GL_FRAMEBUFFER_SRGB);      // encode gcolor on write, it is decoded on read
+    }
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glViewport(0, 0, windowWidth, windowHeight);
+    glViewport(0, 0, renderWidth, renderHeight);
 
     // pass view and projection matrix
     glUniformMatrix4fv(glGetUniformLocation(skyboxProgram, "view"), 1, GL_FALSE, glm::value_ptr(camera.getViewMatrix()));
@@ -658,10 +1729,6 @@ void display()
     glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture);
     glUniform1i(glGetUniformLocation(skyboxProgram, "skybox"), 1);
 
-    // pass zfar and znear to make coord of skybox at the furthest 
-    glUniform1f(glGetUniformLocation(skyboxProgram, "near"), camera.zNear);
-    glUniform1f(glGetUniformLocation(skyboxProgram, "far"), camera.zFar);
-
     // the skybox always follow the camera
     skybox.translate = camera.position;
 
@@ -683,18 +1750,328 @@ void display()
     {
         m.draw(gbufferProgram);
     }
+    glDisable(GL_FRAMEBUFFER_SRGB);
+
+    // ------------------------------------------------------------------------ // 
+
+    FrameCounter++;
+    if (FrameCounter == INT_MAX)
+    {
+        FrameCounter = 0;
+    }
+
+    glDisable(GL_DEPTH_TEST);
+
+    // copy the scene depth into the top of the Hi-Z pyramid and reduce it, only the compute
+    // path classifies tiles with it
+    if (computeClouds) {
+        glBindFramebuffer(GL_FRAMEBUFFER, hizFBO);
+        glUseProgram(hizProgram);
+        glViewport(0, 0, renderWidth, renderHeight);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gdepth);
+        glUniform1i(glGetUniformLocation(hizProgram, "gdepth"), 1);
+
+        screen.draw(hizProgram);
+        reducePyramid(hizFBO, hiztex, renderWidth, renderHeight, hizLevels);
+    }
+    writeTimestamp(STAMP_GBUFFER_END);
+
+    // world size of a cloud pixel per unit of distance, picks the level of detail of the clouds
+    float pixelAngle = 2.0f * tan(glm::radians(camera.fovy) / 2.0f) / cloudHeight;
+
+    // rebuild the lighting lookup tables after a lighting parameter changed
+    if (cloudLutsDirty) {
+        buildCloudLuts();
+        cloudLutsDirty = false;
+    }
+
+    // rebake the clouds when the animation ticks
+    bool cloudTick = !cloudBaked || FrameCounter % cloudUpdateInterval == 0;
+    if (cloudTick) {
+        // bake cloud coverage once per tick instead of once per march step
+        glBindFramebuffer(GL_FRAMEBUFFER, coverageFBO);
+        glUseProgram(coverageProgram);
+        glViewport(0, 0, coverageResolution, coverageResolution);
+
+        glUniform1i(glGetUniformLocation(coverageProgram, "FrameCounter"), FrameCounter);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, shapetex);
+        glUniform1i(glGetUniformLocation(coverageProgram, "shapetex"), 1);
+        glUniform1f(glGetUniformLocation(coverageProgram, "shapeFrequency"), shapeFrequency);
+
+        screen.draw(coverageProgram);
+
+        // the bake is view independent, the level of detail comes from the mips
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, coveragetex);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // reduce coverage to the height range of the clouds in each column
+        glBindFramebuffer(GL_FRAMEBUFFER, extentFBO);
+        glUseProgram(extentProgram);
+        glViewport(0, 0, coverageResolution / extentCellSize, coverageResolution / extentCellSize);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, coveragetex);
+        glUniform1i(glGetUniformLocation(extentProgram, "coveragetex"), 1);
+        glUniform1i(glGetUniformLocation(extentProgram, "cellSize"), extentCellSize);
+
+        screen.draw(extentProgram);
+
+        // reduce the extents into a min/max pyramid for hierarchical skipping
+        int extentResolution = coverageResolution / extentCellSize;
+        reducePyramid(extentFBO, extenttex, extentResolution, extentResolution, extentLevels);
+
+        // integrate the density down each column for the sky light occlusion
+        glBindFramebuffer(GL_FRAMEBUFFER, opacityFBO);
+        glUseProgram(opacityProgram);
+        glViewport(0, 0, opacityResolution, opacityResolution);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, coveragetex);
+        glUniform1i(glGetUniformLocation(opacityProgram, "coveragetex"), 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_3D, detailtex);
+        glUniform1i(glGetUniformLocation(opacityProgram, "detailtex"), 2);
+        glUniform1i(glGetUniformLocation(opacityProgram, "opacitySteps"), opacitySteps);
+
+        screen.draw(opacityProgram);
+    }
+
+    // rebake light transmittance and cloud shadows when the clouds or the light change
+    if (cloudTick || shadowCamera.position != bakedLightPos) {
+        glBindFramebuffer(GL_FRAMEBUFFER, lightingFBO);
+        glUseProgram(lightingProgram);
+        glViewport(0, 0, lightResolution, lightResolution);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, coveragetex);
+        glUniform1i(glGetUniformLocation(lightingProgram, "coveragetex"), 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_3D, detailtex);
+        glUniform1i(glGetUniformLocation(lightingProgram, "detailtex"), 2);
+        glUniform3fv(glGetUniformLocation(lightingProgram, "lightPos"), 1, glm::value_ptr(shadowCamera.position));
+        glUniform1i(glGetUniformLocation(lightingProgram, "layers"), lightLayers);
+        glUniform1i(glGetUniformLocation(lightingProgram, "lightSteps"), lightSteps);
+        glUniform1f(glGetUniformLocation(lightingProgram, "lightAbsorption"), lightAbsorption);
+
+        for (int layer = 0; layer < lightLayers; layer++) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, lighttex, 0, layer);
+            glUniform1i(glGetUniformLocation(lightingProgram, "layer"), layer);
+
+            screen.draw(lightingProgram);
+        }
+
+        // integrate the clouds along the light rays of the shadow camera
+        glBindFramebuffer(GL_FRAMEBUFFER, cloudShadowFBO);
+        glUseProgram(cloudShadowProgram);
+        glViewport(0, 0, cloudShadowResolution, cloudShadowResolution);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, coveragetex);
+        glUniform1i(glGetUniformLocation(cloudShadowProgram, "coveragetex"), 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_3D, detailtex);
+        glUniform1i(glGetUniformLocation(cloudShadowProgram, "detailtex"), 2);
+        glm::mat4 inverseShadowVP = glm::inverse(shadowCamera.getProjectionMatrix(false) * shadowCamera.getViewMatrix(false));
+        glUniformMatrix4fv(glGetUniformLocation(cloudShadowProgram, "inverseShadowVP"), 1, GL_FALSE, glm::value_ptr(inverseShadowVP));
+        glUniform1i(glGetUniformLocation(cloudShadowProgram, "cloudShadowSteps"), cloudShadowSteps);
+        glUniform1f(glGetUniformLocation(cloudShadowProgram, "lightAbsorption"), lightAbsorption);
+
+        screen.draw(cloudShadowProgram);
+        bakedLightPos = shadowCamera.position;
+    }
+    cloudBaked = true;
+
+    // march one band of rows of a panorama face from the camera, the whole panorama
+    // is refreshed every 6 * panoramaBands frames
+    int panoramaFace = panoramaBand / panoramaBands;
+    int bandHeight = panoramaResolution / panoramaBands;
+    glBindFramebuffer(GL_FRAMEBUFFER, panoramaFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + panoramaFace, panoramatex, 0);
+    glUseProgram(panoramaProgram);
+    glViewport(0, panoramaBand % panoramaBands * bandHeight, panoramaResolution, bandHeight);
+
+    bindCloudMarchInputs(panoramaProgram);
+    glUniform1i(glGetUniformLocation(panoramaProgram, "panoramaFace"), panoramaFace);
+    glUniform1f(glGetUniformLocation(panoramaProgram, "panoramaSize"), panoramaResolution);
+    glUniform1i(glGetUniformLocation(panoramaProgram, "noiseSlice"), FrameCounter % noiseSlices);
+    // a face spans 90 degrees
+    glUniform1f(glGetUniformLocation(panoramaProgram, "pixelAngle"), 2.0 / panoramaResolution);
+    glUniform1f(glGetUniformLocation(panoramaProgram, "marchStart"), 0.0);
+
+    screen.draw(panoramaProgram);
+
+    panoramaBand = (panoramaBand + 1) % (6 * panoramaBands);
+    if (panoramaBand == 0) {
+        panoramaReady = true;
+    }
+
+    glm::mat4 inverseVP = glm::inverse(camera.getProjectionMatrix() * camera.getViewMatrix());
+
+    // light and integrate the near clouds and the fog in the froxel volume
+    if (froxelsEnabled) {
+        glUseProgram(froxelProgram);
+        bindCloudMarchInputs(froxelProgram);
+        glUniformMatrix4fv(glGetUniformLocation(froxelProgram, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
+        glUniform1f(glGetUniformLocation(froxelProgram, "froxelNear"), froxelNear);
+        glUniform1f(glGetUniformLocation(froxelProgram, "froxelFar"), froxelFar);
+        glUniform1f(glGetUniformLocation(froxelProgram, "fogDensity"), fogDensity);
+        glUniform1f(glGetUniformLocation(froxelProgram, "fogBase"), fogBase);
+        glUniform1f(glGetUniformLocation(froxelProgram, "fogFalloff"), fogFalloff);
+        glUniform3fv(glGetUniformLocation(froxelProgram, "fogColor"), 1, glm::value_ptr(fogColor));
+        glUniform1i(glGetUniformLocation(froxelProgram, "froxelImage"), 0);
+        glBindImageTexture(0, froxelScattertex, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glDispatchCompute((froxelWidth + 7) / 8, (froxelHeight + 7) / 8, froxelDepth);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        glUseProgram(froxelIntegrateProgram);
+        glUniform1f(glGetUniformLocation(froxelIntegrateProgram, "froxelNear"), froxelNear);
+        glUniform1f(glGetUniformLocation(froxelIntegrateProgram, "froxelFar"), froxelFar);
+        glUniform1i(glGetUniformLocation(froxelIntegrateProgram, "froxelImage"), 0);
+        glUniform1i(glGetUniformLocation(froxelIntegrateProgram, "integratedImage"), 1);
+        glBindImageTexture(1, froxeltex, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindImageTexture(0, froxelScattertex, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
+        glDispatchCompute((froxelWidth + 7) / 8, (froxelHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+
+    // march clouds into their own target at a fraction of the window resolution
+    // in temporal mode only one pixel of every 4x4 block is marched
+    writeTimestamp(STAMP_CLOUD_BEGIN);
+    int cloudBlock = temporalClouds ? 4 : 1;
+    int* cloudOffset = bayerOffset[temporalClouds ? FrameCounter % 16 : 0];
+
+    int marchWidth = (cloudWidth + cloudBlock - 1) / cloudBlock;
+    int marchHeight = (cloudHeight + cloudBlock - 1) / cloudBlock;
+    // the compute path classifies tiles and runs a kernel per class, all programs share the pass inputs
+    std::vector<GLuint> cloudPassPrograms = { cloudProgram };
+    if (computeClouds) {
+        cloudPassPrograms = { classifyProgram, cloudSkyProgram, cloudComputeProgram };
+    }
+    for (GLuint cloudPassProgram : cloudPassPrograms) {
+        glUseProgram(cloudPassProgram);
+
+        // pass gdepth texture
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gdepth);
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "gdepth"), 1);
+        bindCloudMarchInputs(cloudPassProgram);
+
+        // pass Hi-Z depth pyramid
+        glActiveTexture(GL_TEXTURE8);
+        glBindTexture(GL_TEXTURE_2D, hiztex);
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "hiztex"), 8);
+
+        // pass distant cloud panorama
+        glActiveTexture(GL_TEXTURE7);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, panoramatex);
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "panoramatex"), 7);
+        glUniform1f(glGetUniformLocation(cloudPassProgram, "panoramaDistance"), panoramaDistance);
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "panoramaReady"), panoramaReady);
+
+        // pass inverse view projection matrix of the camera to rebuild rays and positions from gdepth
+        glUniformMatrix4fv(glGetUniformLocation(cloudPassProgram, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
+
+        // pass interleaved marching block
+        glUniform2f(glGetUniformLocation(cloudPassProgram, "cloudSize"), cloudWidth, cloudHeight);
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "cloudBlock"), cloudBlock);
+        glUniform2i(glGetUniformLocation(cloudPassProgram, "cloudOffset"), cloudOffset[0], cloudOffset[1]);
+        // a pixel is marched once per block, so step the noise slice once per block cycle
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "noiseSlice"), FrameCounter / (cloudBlock * cloudBlock) % noiseSlices);
+        glUniform1f(glGetUniformLocation(cloudPassProgram, "pixelAngle"), pixelAngle);
+        // clouds nearer than froxelFar are in the froxel volume
+        glUniform1f(glGetUniformLocation(cloudPassProgram, "marchStart"), froxelsEnabled ? froxelFar : 0.0);
+
+        // compute kernels write the target as an image
+        glUniform1i(glGetUniformLocation(cloudPassProgram, "cloudImage"), 0);
+        glUniform1ui(glGetUniformLocation(cloudPassProgram, "tileCapacity"), tileCapacity);
+    }
+
+    if (computeClouds) {
+        // reset the tile counts, the y and z group counts of each dispatch stay 1
+        GLuint dispatchArgs[6] = { 0, 1, 1, 0, 1, 1 };
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tileBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(dispatchArgs), dispatchArgs);
+        glBindImageTexture(0, temporalClouds ? marchtex : cloudtex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+        // one work group per 16x16 tile of the output
+        glUseProgram(classifyProgram);
+        glDispatchCompute((marchWidth + 15) / 16, (marchHeight + 15) / 16, 1);
+        // tile lists and counts must land before the indirect dispatches read them
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        // one work group per listed tile of each class
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, tileBuffer);
+        glUseProgram(cloudSkyProgram);
+        glDispatchComputeIndirect(0);
+        glUseProgram(cloudComputeProgram);
+        glDispatchComputeIndirect(3 * sizeof(GLuint));
+        // image writes must land before the next passes sample the texture
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, temporalClouds ? marchFBO : cloudFBO);
+        glViewport(0, 0, marchWidth, marchHeight);
+        screen.draw(cloudProgram);
+    }
+
+    if (cloudComparisonRequested) {
+        compareCloudReference(inverseVP, pixelAngle);
+        cloudComparisonRequested = false;
+    }
+
+    // rebuild the full cloud target from the marched pixels and the reprojected history
+    if (temporalClouds) {
+        historyIndex = 1 - historyIndex;
+        if (historySize[historyIndex] != glm::ivec2(cloudWidth, cloudHeight)) {
+            historySize[historyIndex] = glm::ivec2(cloudWidth, cloudHeight);
+            glBindTexture(GL_TEXTURE_2D, historytex[historyIndex]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, cloudWidth, cloudHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFBO[historyIndex]);
+        glUseProgram(reprojectProgram);
+        glViewport(0, 0, cloudWidth, cloudHeight);
+
+        // pass gdepth texture
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gdepth);
+        glUniform1i(glGetUniformLocation(reprojectProgram, "gdepth"), 1);
+        // pass marched pixels
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, marchtex);
+        glUniform1i(glGetUniformLocation(reprojectProgram, "marchtex"), 2);
+        // pass last frame clouds
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, historytex[1 - historyIndex]);
+        glUniform1i(glGetUniformLocation(reprojectProgram, "historytex"), 3);
+
+        // pass camera position and matrices of this and the previous frame
+        glUniform3fv(glGetUniformLocation(reprojectProgram, "cameraPos"), 1, glm::value_ptr(camera.position));
+        glUniformMatrix4fv(glGetUniformLocation(reprojectProgram, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
+        glUniformMatrix4fv(glGetUniformLocation(reprojectProgram, "prevVP"), 1, GL_FALSE, glm::value_ptr(prevVP));
+
+        glUniform1i(glGetUniformLocation(reprojectProgram, "cloudBlock"), cloudBlock);
+        glUniform2i(glGetUniformLocation(reprojectProgram, "cloudOffset"), cloudOffset[0], cloudOffset[1]);
+        glUniform1i(glGetUniformLocation(reprojectProgram, "historyValid"), historyValid);
+
+        screen.draw(reprojectProgram);
+        historyValid = true;
+    }
+    prevVP = camera.getProjectionMatrix() * camera.getViewMatrix();
+    glEnable(GL_DEPTH_TEST);
+    writeTimestamp(STAMP_CLOUD_END);
 
     // ------------------------------------------------------------------------ // 
 
     // post processingrender with composite0 shader
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // straight to the window at full resolution, else at the gbuffer resolution to be upscaled
+    bool upscale = renderWidth != windowWidth || renderHeight != windowHeight;
+    glBindFramebuffer(GL_FRAMEBUFFER, upscale ? sceneFBO : 0);
     glDisable(GL_DEPTH_TEST);
     glUseProgram(composite0);
-    glViewport(0, 0, windowWidth, windowHeight);
-
-    // pass zfar and znear to transfer to linear depth 
-    glUniform1f(glGetUniformLocation(composite0, "near"), camera.zNear);
-    glUniform1f(glGetUniformLocation(composite0, "far"), camera.zFar);
+    glViewport(0, 0, renderWidth, renderHeight);
 
     // pass gcolor texture
     glActiveTexture(GL_TEXTURE1);
@@ -704,10 +2081,6 @@ void display()
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, gnormal);
     glUniform1i(glGetUniformLocation(composite0, "gnormal"), 2);
-    // pass gworldpos texture
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, gworldpos);
-    glUniform1i(glGetUniformLocation(composite0, "gworldpos"), 3);
     // pass gdepth texture
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_2D, gdepth);
@@ -720,29 +2093,52 @@ void display()
     glActiveTexture(GL_TEXTURE6);
     glBindTexture(GL_TEXTURE_2D, noisetex);
     glUniform1i(glGetUniformLocation(composite0, "noisetex"), 6);
+    // pass low resolution cloud texture
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, temporalClouds ? historytex[historyIndex] : cloudtex);
+    glUniform1i(glGetUniformLocation(composite0, "cloudtex"), 7);
+    // pass cloud shadow texture
+    glActiveTexture(GL_TEXTURE8);
+    glBindTexture(GL_TEXTURE_2D, cloudshadowtex);
+    glUniform1i(glGetUniformLocation(composite0, "cloudshadowtex"), 8);
+    // pass froxel volume of near clouds and fog
+    glActiveTexture(GL_TEXTURE9);
+    glBindTexture(GL_TEXTURE_3D, froxeltex);
+    glUniform1i(glGetUniformLocation(composite0, "froxeltex"), 9);
+    glUniform1i(glGetUniformLocation(composite0, "useFroxels"), froxelsEnabled);
+    glUniform1f(glGetUniformLocation(composite0, "froxelNear"), froxelNear);
+    glUniform1f(glGetUniformLocation(composite0, "froxelFar"), froxelFar);
 
     // pass transformation matrix of the light source coord
     glm::mat4 shadowVP = shadowCamera.getProjectionMatrix(false) * shadowCamera.getViewMatrix(false);
     glUniformMatrix4fv(glGetUniformLocation(composite0, "shadowVP"), 1, GL_FALSE, glm::value_ptr(shadowVP));
+    // pass inverse view projection matrix of the camera to rebuild positions from gdepth
+    glUniformMatrix4fv(glGetUniformLocation(composite0, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
 
     // pass light position
     glUniform3fv(glGetUniformLocation(composite0, "lightPos"), 1, glm::value_ptr(shadowCamera.position));
     // pass camera position
     glUniform3fv(glGetUniformLocation(composite0, "cameraPos"), 1, glm::value_ptr(camera.position));
 
-    // pass view matrix
-    glUniformMatrix4fv(glGetUniformLocation(composite0, "view"), 1, GL_FALSE, glm::value_ptr(shadowCamera.getViewMatrix(false)));
-    // pass projection matrix
-    glUniformMatrix4fv(glGetUniformLocation(composite0, "projection"), 1, GL_FALSE, glm::value_ptr(shadowCamera.getProjectionMatrix(false)));
-
-    FrameCounter++;
-    if (FrameCounter == INT_MAX)
-    {
-        FrameCounter = 0;
-    }
-    glUniform1i(glGetUniformLocation(composite0, "FrameCounter"), FrameCounter);
+    // pass zfar and znear to compare linear depth when upsampling clouds
+    glUniform1f(glGetUniformLocation(composite0, "near"), camera.zNear);
+    glUniform1f(glGetUniformLocation(composite0, "far"), camera.zFar);
 
     screen.draw(composite0);
+    writeTimestamp(STAMP_COMPOSITE_END);
+
+    // upscale the composited frame to the window
+    if (upscale) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glUseProgram(upscaleProgram);
+        glViewport(0, 0, windowWidth, windowHeight);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, scenetex);
+        glUniform1i(glGetUniformLocation(upscaleProgram, "scenetex"), 1);
+
+        screen.draw(upscaleProgram);
+    }
     glEnable(GL_DEPTH_TEST);
 
     // ------------------------------------------------------------------------ // 
@@ -757,6 +2153,8 @@ void display()
     // pass zfar and znear to transform to linera depth
     glUniform1f(glGetUniformLocation(debugProgram, "near"), camera.zNear);
     glUniform1f(glGetUniformLocation(debugProgram, "far"), camera.zFar);
+    // pass inverse view projection matrix to rebuild positions from gdepth
+    glUniformMatrix4fv(glGetUniformLocation(debugProgram, "inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
 
     // pass gcolor texture
     glActiveTexture(GL_TEXTURE1);
@@ -766,10 +2164,6 @@ void display()
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_2D, gnormal);
     glUniform1i(glGetUniformLocation(debugProgram, "gnormal"), 2);
-    // pass gworldpos texture
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, gworldpos);
-    glUniform1i(glGetUniformLocation(debugProgram, "gworldpos"), 3);
     // pass gdepth texture
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_2D, gdepth);
@@ -785,6 +2179,9 @@ void display()
 
     // ------------------------------------------------------------------------ // 
 
+    writeTimestamp(STAMP_FRAME_END);
+    timerFrame++;
+
     glutSwapBuffers();               
 }
 
@@ -793,6 +2190,12 @@ void display()
 int main(int argc, char** argv)
 {
     glutInit(&argc, argv);              
+    // gbuffer layout, the compact one unless asked otherwise
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--plain-gbuffer") {
+            compactGBuffer = false;
+        }
+    }
     glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH);
     glutInitWindowSize(windowWidth, windowHeight);
     glutCreateWindow("rendering window"); 
@@ -816,6 +2219,7 @@ int main(int argc, char** argv)
     glutSpecialUpFunc(keyboardUpSpecial);
 
     glutDisplayFunc(display);           // display call back function and implement every frame 
+    glutReshapeFunc(reshape);           // resize the screen sized targets with the window
     glutMainLoop();                    
 
     return 0;
@@ -0,0 +1,156 @@
+// Offline blue noise generator
+// Builds a set of void-and-cluster blue noise slices and writes them stacked
+// vertically into one 24 bit bmp that main.cpp loads as noisetex.
+//
+//   g++ -O2 -o bluenoise tools/bluenoise.cpp
+//   ./bluenoise textures/bluenoise.bmp
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#define SIZE 64         // slice width and height, tiles seamlessly
+#define SLICES 16       // slices cycled by FrameCounter
+#define SIGMA 1.5       // gaussian filter radius of the energy
+#define INITIAL 0.1     // fraction of pixels in the initial binary pattern
+
+// gaussian energy contribution between two pixels on the torus
+std::vector<float> buildKernel()
+{
+    std::vector<float> kernel(SIZE * SIZE);
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            int dx = std::min(x, SIZE - x);
+            int dy = std::min(y, SIZE - y);
+            kernel[y * SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+        }
+    }
+    return kernel;
+}
+
+// add (sign 1) or remove (sign -1) a point to the energy field
+void splat(std::vector<float>& energy, const std::vector<float>& kernel, int p, float sign)
+{
+    int px = p % SIZE, py = p / SIZE;
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < SIZE; x++) {
+            int kx = (x - px + SIZE) % SIZE;
+            int ky = (y - py + SIZE) % SIZE;
+            energy[y * SIZE + x] += sign * kernel[ky * SIZE + kx];
+        }
+    }
+}
+
+// tightest cluster is the set pixel with most energy, largest void the empty one with least
+int findExtreme(const std::vector<float>& energy, const std::vector<bool>& pattern, bool cluster)
+{
+    int best = -1;
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        if (pattern[i] != cluster) continue;
+        if (best < 0 || (cluster ? energy[i] > energy[best] : energy[i] < energy[best])) best = i;
+    }
+    return best;
+}
+
+// void-and-cluster (Ulichney 1993), returns the rank of every pixel
+std::vector<int> voidAndCluster(const std::vector<float>& kernel, unsigned int seed)
+{
+    const int N = SIZE * SIZE;
+    std::mt19937 rng(seed);
+
+    // random initial pattern
+    std::vector<bool> pattern(N, false);
+    std::vector<float> energy(N, 0.0f);
+    int ones = 0;
+    while (ones < N * INITIAL) {
+        int p = rng() % N;
+        if (pattern[p]) continue;
+        pattern[p] = true;
+        splat(energy, kernel, p, 1.0f);
+        ones++;
+    }
+
+    // relax it by moving the tightest cluster into the largest void until stable
+    for (;;) {
+        int cluster = findExtreme(energy, pattern, true);
+        pattern[cluster] = false;
+        splat(energy, kernel, cluster, -1.0f);
+        int hole = findExtreme(energy, pattern, false);
+        pattern[hole] = true;
+        splat(energy, kernel, hole, 1.0f);
+        if (hole == cluster) break;
+    }
+
+    std::vector<int> rank(N);
+
+    // phase 1: rank the initial points by removing tightest clusters
+    std::vector<bool> prototype = pattern;
+    std::vector<float> prototypeEnergy = energy;
+    for (int r = ones - 1; r >= 0; r--) {
+        int cluster = findExtreme(energy, pattern, true);
+        pattern[cluster] = false;
+        splat(energy, kernel, cluster, -1.0f);
+        rank[cluster] = r;
+    }
+
+    // phase 2 and 3: fill largest voids, the void of the ones is the cluster of the zeros
+    pattern = prototype;
+    energy = prototypeEnergy;
+    for (int r = ones; r < N; r++) {
+        int hole = findExtreme(energy, pattern, false);
+        pattern[hole] = true;
+        splat(energy, kernel, hole, 1.0f);
+        rank[hole] = r;
+    }
+    return rank;
+}
+
+void writeBMP(const char* path, const std::vector<unsigned char>& gray, int width, int height)
+{
+    int rowSize = (width * 3 + 3) & ~3;
+    int dataSize = rowSize * height;
+    unsigned char header[54] = { 'B', 'M' };
+    auto put = [&](int offset, int value) {
+        for (int i = 0; i < 4; i++) header[offset + i] = (value >> (8 * i)) & 0xff;
+    };
+    put(2, 54 + dataSize);  // file size
+    put(10, 54);            // pixel data offset
+    put(14, 40);            // info header size
+    put(18, width);
+    put(22, height);
+    header[26] = 1;         // planes
+    header[28] = 24;        // bits per pixel
+    put(34, dataSize);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((char*)header, 54);
+    std::vector<unsigned char> row(rowSize, 0);
+    for (int y = height - 1; y >= 0; y--) {     // bmp rows are bottom up
+        for (int x = 0; x < width; x++) {
+            unsigned char v = gray[y * width + x];
+            row[x * 3 + 0] = row[x * 3 + 1] = row[x * 3 + 2] = v;
+        }
+        file.write((char*)row.data(), rowSize);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : "textures/bluenoise.bmp";
+    std::vector<float> kernel = buildKernel();
+
+    std::vector<unsigned char> gray(SIZE * SIZE * SLICES);
+    for (int s = 0; s < SLICES; s++) {
+        std::vector<int> rank = voidAndCluster(kernel, 1234 + s);
+        for (int i = 0; i < SIZE * SIZE; i++) {
+            gray[s * SIZE * SIZE + i] = (unsigned char)(rank[i] * 256 / (SIZE * SIZE));
+        }
+        std::cout << "slice " << s + 1 << "/" << SLICES << std::endl;
+    }
+
+    writeBMP(path, gray, SIZE, SIZE * SLICES);
+    std::cout << "wrote " << path << std::endl;
+    return 0;
+}